@@ -0,0 +1,298 @@
+/** bench.c - times the phases of the loader on a project
+* made by gen_project, printing the time and the peak memory
+* of each phase so changes to the loader can be compared */
+
+// getopt and clock_gettime, strict c2x leaves them out
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "ldtk.h"
+
+/** what one phase produced, summed over its iterations */
+typedef struct bench_counts {
+	u64 walls, tiles, ents;
+} bench_counts;
+
+/** the pipe a phase child writes its bench_counts to, -1 in the parent */
+static int counts_fd = -1;
+
+static f64 now_ms(void);
+static long peak_kb(void);
+static bench_counts run_phase(void (*phase)(char *dir, LDTK_FLAGS flags,
+					    u32 iters),
+			      char *dir, LDTK_FLAGS flags, u32 iters);
+static void bench_load_nomesh(char *dir, LDTK_FLAGS flags, u32 iters);
+static void bench_load_greedy(char *dir, LDTK_FLAGS flags, u32 iters);
+static void bench_load_legacy(char *dir, LDTK_FLAGS flags, u32 iters);
+static void report(const char *phase, u32 iters, f64 ms, u64 items,
+		   const char *unit);
+static void bench_init(char *dir, LDTK_FLAGS flags, u32 iters);
+static void bench_load(char *dir, LDTK_FLAGS flags, u32 iters,
+		       const char *phase);
+static void bench_fields(char *dir, LDTK_FLAGS flags, u32 iters);
+static void count_lvl(ldtk_lvl *lvl, bench_counts *counts);
+static u32 field_count(ldtk_lvl **lvls, u32 len);
+
+int main(int argc, char **argv)
+{
+	u32 iters = 10;
+	LDTK_FLAGS flags = LDTK_EXTENSION_LDTK;
+	int c;
+	while ((c = getopt(argc, argv, "i:x:")) != -1) {
+		switch (c) {
+		case 'i':
+			iters = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			flags |= strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-i iters] [-x flags] dir\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || iters == 0) {
+		fprintf(stderr, "usage: %s [-i iters] [-x flags] dir\n", argv[0]);
+		return 1;
+	}
+	// ldtk_init_ctx wants the trailing /
+	char dir[4096];
+	snprintf(dir, sizeof(dir), "%s/", argv[optind]);
+
+	printf("%-14s %6s %12s %14s %12s\n", "phase", "iters", "ms/iter",
+	       "ns/item", "peak_kb");
+	run_phase(bench_init, dir, flags, iters);
+	run_phase(bench_load_nomesh, dir, flags, iters);
+	bench_counts greedy = run_phase(bench_load_greedy, dir, flags, iters);
+	bench_counts legacy = run_phase(bench_load_legacy, dir, flags, iters);
+	run_phase(bench_fields, dir, flags, iters);
+
+	// the rle mesher promises the same or fewer walls than the legacy one
+	if (greedy.walls > legacy.walls) {
+		fprintf(stderr, "load_greedy made %llu walls, load_legacy %llu\n",
+			(unsigned long long)greedy.walls,
+			(unsigned long long)legacy.walls);
+		return 1;
+	}
+	return 0;
+}
+
+static f64 now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/** \brief the peak resident size of the process so far */
+static long peak_kb(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/** \brief runs a phase in a child process, so its peak memory
+ * is its own and not the largest of the phases before it
+ * \return what the phase counted, 0 for phases that count nothing */
+static bench_counts run_phase(void (*phase)(char *dir, LDTK_FLAGS flags,
+					    u32 iters),
+			      char *dir, LDTK_FLAGS flags, u32 iters)
+{
+	int fds[2];
+	if (pipe(fds) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		counts_fd = fds[1];
+		phase(dir, flags, iters);
+		fflush(stdout);
+		_exit(0);
+	}
+	close(fds[1]);
+	bench_counts counts = { 0 };
+	if (read(fds[0], &counts, sizeof(counts)) != sizeof(counts)) {
+		counts = (bench_counts){ 0 };
+	}
+	close(fds[0]);
+	int status = 0;
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "phase failed\n");
+		exit(1);
+	}
+	return counts;
+}
+
+static void report(const char *phase, u32 iters, f64 ms, u64 items,
+		   const char *unit)
+{
+	f64 per_item = items > 0 ? ms * 1e6 / items : 0;
+	printf("%-14s %6u %12.3f %14.1f %12ld  %llu %s\n", phase, iters,
+	       ms / iters, per_item, peak_kb(), (unsigned long long)items,
+	       unit);
+}
+
+/** \brief parsing the project and building the level index */
+static void bench_init(char *dir, LDTK_FLAGS flags, u32 iters)
+{
+	u64 levels = 0;
+	f64 start = now_ms();
+	for (u32 i = 0; i < iters; i++) {
+		ldtk_ctx *ctx = ldtk_init_ctx(16, "prj", dir, flags);
+		levels += ldtk_get_lvl_index_ctx(ctx)->len;
+		ldtk_free_ctx(ctx);
+	}
+	report("init", iters, now_ms() - start, levels, "levels");
+}
+
+/** \brief loading and destroying every level of the index, run without
+ * meshing (a wall per cell), with the rle greedy mesher of
+ * LDTK_LEVEL_GREEDY_MESH and with the legacy one, so the meshing
+ * cost shows in the difference */
+static void bench_load(char *dir, LDTK_FLAGS flags, u32 iters,
+		       const char *phase)
+{
+	ldtk_ctx *ctx = ldtk_init_ctx(16, "prj", dir, flags);
+	bunlist *index = ldtk_get_lvl_index_ctx(ctx);
+	bench_counts counts = { 0 };
+	f64 start = now_ms();
+	for (u32 i = 0; i < iters; i++) {
+		for (u32 l = 0; l < index->len; l++) {
+			ldtk_lvl_info *info = bunlist_get(index, l);
+			ldtk_lvl *lvl = ldtk_load_lvl_ctx(ctx, info->identifier);
+			if (lvl == NULL) {
+				fprintf(stderr, "can't load %s\n", info->identifier);
+				exit(1);
+			}
+			count_lvl(lvl, &counts);
+			ldtk_destroy_lvl(lvl);
+		}
+	}
+	f64 ms = now_ms() - start;
+	report(phase, iters, ms, (u64)index->len * iters, "levels");
+	if (counts_fd >= 0 &&
+	    write(counts_fd, &counts, sizeof(counts)) != sizeof(counts)) {
+		perror("write");
+	}
+	printf("%-14s walls=%llu tiles=%llu ents=%llu per iteration\n", "",
+	       (unsigned long long)counts.walls / iters,
+	       (unsigned long long)counts.tiles / iters,
+	       (unsigned long long)counts.ents / iters);
+	ldtk_free_ctx(ctx);
+}
+
+static void bench_load_nomesh(char *dir, LDTK_FLAGS flags, u32 iters)
+{
+	bench_load(dir, flags, iters, "load_nomesh");
+}
+
+static void bench_load_greedy(char *dir, LDTK_FLAGS flags, u32 iters)
+{
+	bench_load(dir, flags | LDTK_LEVEL_GREEDY_MESH, iters, "load_greedy");
+}
+
+static void bench_load_legacy(char *dir, LDTK_FLAGS flags, u32 iters)
+{
+	bench_load(dir, flags | LDTK_LEVEL_GREEDY_MESH_LEGACY, iters,
+		   "load_legacy");
+}
+
+/** \brief reads every entity field by name, once as malloc'ed copies
+ * with ldtk_get_ent_field and once in place with ldtk_field_get */
+static void bench_fields(char *dir, LDTK_FLAGS flags, u32 iters)
+{
+	ldtk_ctx *ctx = ldtk_init_ctx(16, "prj", dir, flags);
+	bunlist *index = ldtk_get_lvl_index_ctx(ctx);
+	ldtk_lvl **lvls = malloc(sizeof(ldtk_lvl *) * (index->len + 1));
+	for (u32 l = 0; l < index->len; l++) {
+		ldtk_lvl_info *info = bunlist_get(index, l);
+		lvls[l] = ldtk_load_lvl_ctx(ctx, info->identifier);
+	}
+	u32 fields = field_count(lvls, index->len);
+	char name[16];
+
+	u64 lookups = 0, found = 0;
+	f64 start = now_ms();
+	for (u32 i = 0; i < iters; i++) {
+		for (u32 l = 0; l < index->len; l++) {
+			ldtk_ent_index *ents = lvls[l]->ent_index;
+			for (u32 e = 0; e < ents->ent_count; e++) {
+				for (u32 f = 0; f < fields; f++) {
+					snprintf(name, sizeof(name), "f%u", f);
+					void *value =
+						ldtk_get_ent_field(ents->ents[e], name);
+					found += value != NULL;
+					lookups++;
+					free(value);
+				}
+			}
+		}
+	}
+	report("get_ent_field", iters, now_ms() - start, lookups, "lookups");
+	printf("%-14s %llu found, points and arrays have no copy\n", "",
+	       (unsigned long long)found);
+
+	lookups = 0;
+	start = now_ms();
+	for (u32 i = 0; i < iters; i++) {
+		for (u32 l = 0; l < index->len; l++) {
+			ldtk_ent_index *ents = lvls[l]->ent_index;
+			for (u32 e = 0; e < ents->ent_count; e++) {
+				for (u32 f = 0; f < fields; f++) {
+					snprintf(name, sizeof(name), "f%u", f);
+					ldtk_field_get(ents->ents[e]->fields, name);
+					lookups++;
+				}
+			}
+		}
+	}
+	report("field_get", iters, now_ms() - start, lookups, "lookups");
+
+	for (u32 l = 0; l < index->len; l++) {
+		ldtk_destroy_lvl(lvls[l]);
+	}
+	free(lvls);
+	ldtk_free_ctx(ctx);
+}
+
+static void count_lvl(ldtk_lvl *lvl, bench_counts *counts)
+{
+	counts->walls += lvl->walls->len;
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type == LDTK_LAYER_ENTITY) {
+			counts->ents += layer->content->len;
+		} else {
+			counts->tiles += ldtk_layer_tile_count(layer);
+		}
+	}
+}
+
+/** \brief the number of f0, f1.. fields the generator gave the entities */
+static u32 field_count(ldtk_lvl **lvls, u32 len)
+{
+	char name[16];
+	for (u32 l = 0; l < len; l++) {
+		ldtk_ent_index *ents = lvls[l]->ent_index;
+		if (ents == NULL || ents->ent_count == 0)
+			continue;
+		u32 f = 0;
+		snprintf(name, sizeof(name), "f%u", f);
+		while (ldtk_field_get(ents->ents[0]->fields, name) != NULL) {
+			snprintf(name, sizeof(name), "f%u", ++f);
+		}
+		return f;
+	}
+	return 0;
+}
@@ -0,0 +1,387 @@
+/** gen_project.c - writes a synthetic ldtk project for the
+* benchmarks, the same options and seed always give the same
+* files. levels are laid out as a gridvania with neighbours */
+
+// getopt, strict c2x leaves it out
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TILE 16
+
+/** what the project looks like, set from the command line */
+typedef struct gen_opts {
+	int levels;
+	int grid_w, grid_h; // cells per level
+	int density; // percent of cells with an intgrid value or a tile
+	int ents; // per level
+	int fields; // per entity
+	int multi; // one .ldtkl file per level
+	unsigned seed;
+} gen_opts;
+
+static unsigned long long rng_state;
+
+static unsigned rng(void);
+static void write_level(FILE *out, gen_opts *opts, int i);
+static void write_grid_layer(FILE *out, gen_opts *opts, int i);
+static void write_tile_layer(FILE *out, gen_opts *opts, int i);
+static void write_ent_layer(FILE *out, gen_opts *opts, int i);
+static void write_fields(FILE *out, int count, int seed);
+static void write_ngbrs(FILE *out, gen_opts *opts, int i);
+static void write_project(FILE *out, gen_opts *opts);
+static int columns(gen_opts *opts);
+static void usage(char *name);
+
+int main(int argc, char **argv)
+{
+	gen_opts opts = { 16, 64, 64, 30, 20, 4, 0, 1 };
+	int c;
+	while ((c = getopt(argc, argv, "l:w:h:d:e:f:ms:")) != -1) {
+		switch (c) {
+		case 'l':
+			opts.levels = atoi(optarg);
+			break;
+		case 'w':
+			opts.grid_w = atoi(optarg);
+			break;
+		case 'h':
+			opts.grid_h = atoi(optarg);
+			break;
+		case 'd':
+			opts.density = atoi(optarg);
+			break;
+		case 'e':
+			opts.ents = atoi(optarg);
+			break;
+		case 'f':
+			opts.fields = atoi(optarg);
+			break;
+		case 'm':
+			opts.multi = 1;
+			break;
+		case 's':
+			opts.seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || opts.levels < 1 || opts.grid_w < 1 ||
+	    opts.grid_h < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	char *dir = argv[optind];
+	char path[4096];
+	mkdir(dir, 0755);
+	if (opts.multi) {
+		snprintf(path, sizeof(path), "%s/prj", dir);
+		mkdir(path, 0755);
+	}
+
+	snprintf(path, sizeof(path), "%s/prj.ldtk", dir);
+	FILE *out = fopen(path, "w");
+	if (out == NULL) {
+		perror(path);
+		return 1;
+	}
+	write_project(out, &opts);
+	fclose(out);
+
+	for (int i = 0; opts.multi && i < opts.levels; i++) {
+		snprintf(path, sizeof(path), "%s/prj/Level_%d.ldtkl", dir, i);
+		out = fopen(path, "w");
+		if (out == NULL) {
+			perror(path);
+			return 1;
+		}
+		write_level(out, &opts, i);
+		fputc('\n', out);
+		fclose(out);
+	}
+	return 0;
+}
+
+/** \brief splitmix64, so the output doesn't depend on the libc rand */
+static unsigned rng(void)
+{
+	unsigned long long z = (rng_state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return (z ^ (z >> 31)) >> 32;
+}
+
+static void write_project(FILE *out, gen_opts *opts)
+{
+	fprintf(out,
+		"{\"iid\": \"prj\", \"jsonVersion\": \"1.5.3\", "
+		"\"worldLayout\": \"GridVania\", \"externalLevels\": %s, "
+		"\"simplifiedExport\": false, \"imageExportMode\": \"None\", "
+		"\"defaultGridSize\": %d,\n",
+		opts->multi ? "true" : "false", TILE);
+	fprintf(out,
+		"\"defs\": {\"layers\": [], \"enums\": [],\n"
+		"\"tilesets\": [{\"uid\": 1, \"identifier\": \"Tiles\", "
+		"\"relPath\": \"gfx/tiles.png\", \"pxWid\": 256, \"pxHei\": 256, "
+		"\"tileGridSize\": %d, \"spacing\": 0, \"padding\": 0, "
+		"\"__cWid\": 16, \"__cHei\": 16}],\n"
+		"\"entities\": [", TILE);
+	static const char *types[] = { "Enemy", "Chest", "Spawner", "Door" };
+	for (int i = 0; i < 4; i++) {
+		fprintf(out,
+			"%s{\"identifier\": \"%s\", \"uid\": %d, \"tags\": [], "
+			"\"pivotX\": 0.5, \"pivotY\": 1}",
+			i > 0 ? ", " : "", types[i], 10 + i);
+	}
+	fprintf(out, "]},\n\"worlds\": [],\n\"levels\": [\n");
+
+	for (int i = 0; i < opts->levels; i++) {
+		if (i > 0)
+			fprintf(out, ",\n");
+		if (!opts->multi) {
+			write_level(out, opts, i);
+			continue;
+		}
+		int gx = i % columns(opts), gy = i / columns(opts);
+		fprintf(out,
+			"{\"identifier\": \"Level_%d\", \"iid\": \"lvl-%d\", "
+			"\"uid\": %d, \"worldX\": %d, \"worldY\": %d, "
+			"\"worldDepth\": 0, \"pxWid\": %d, \"pxHei\": %d, "
+			"\"__bgColor\": \"#40465B\", \"bgColor\": null, "
+			"\"bgRelPath\": null, \"layerInstances\": null, "
+			"\"externalRelPath\": \"prj/Level_%d.ldtkl\", "
+			"\"fieldInstances\": [], ",
+			i, i, i, gx * opts->grid_w * TILE,
+			gy * opts->grid_h * TILE, opts->grid_w * TILE,
+			opts->grid_h * TILE, i);
+		write_ngbrs(out, opts, i);
+		fputc('}', out);
+	}
+	fprintf(out, "\n]}\n");
+}
+
+/** \brief the levels of the world grid per row, about a square */
+static int columns(gen_opts *opts)
+{
+	int c = 1;
+	while (c * c < opts->levels) {
+		c++;
+	}
+	return c;
+}
+
+static void write_level(FILE *out, gen_opts *opts, int i)
+{
+	// every level has its own stream, so single and multi file match
+	rng_state = (unsigned long long)opts->seed << 32 | (unsigned)i;
+	int gx = i % columns(opts), gy = i / columns(opts);
+	fprintf(out,
+		"{\"identifier\": \"Level_%d\", \"iid\": \"lvl-%d\", \"uid\": %d, "
+		"\"worldX\": %d, \"worldY\": %d, \"worldDepth\": 0, "
+		"\"pxWid\": %d, \"pxHei\": %d, \"__bgColor\": \"#40465B\", "
+		"\"bgColor\": null, \"bgRelPath\": null, "
+		"\"externalRelPath\": null,\n\"fieldInstances\": ",
+		i, i, i, gx * opts->grid_w * TILE, gy * opts->grid_h * TILE,
+		opts->grid_w * TILE, opts->grid_h * TILE);
+	write_fields(out, 2, i);
+	fprintf(out, ",\n");
+	write_ngbrs(out, opts, i);
+	fprintf(out, ",\n\"layerInstances\": [\n");
+	write_ent_layer(out, opts, i);
+	fprintf(out, ",\n");
+	write_grid_layer(out, opts, i);
+	fprintf(out, ",\n");
+	write_tile_layer(out, opts, i);
+	fprintf(out, "\n]}");
+}
+
+static void write_ngbrs(FILE *out, gen_opts *opts, int i)
+{
+	int cols = columns(opts);
+	int gx = i % cols, gy = i / cols;
+	static const int dx[] = { 1, -1, 0, 0 }, dy[] = { 0, 0, 1, -1 };
+	static const char dir[] = { 'e', 'w', 's', 'n' };
+	int first = 1;
+	fprintf(out, "\"__neighbours\": [");
+	for (int d = 0; d < 4; d++) {
+		int nx = gx + dx[d], ny = gy + dy[d];
+		int n = ny * cols + nx;
+		if (nx < 0 || ny < 0 || nx >= cols || n >= opts->levels)
+			continue;
+		fprintf(out, "%s{\"levelIid\": \"lvl-%d\", \"dir\": \"%c\"}",
+			first ? "" : ", ", n, dir[d]);
+		first = 0;
+	}
+	fprintf(out, "]");
+}
+
+/** \brief an intgrid with solid borders, a few rectangles so the mesher
+ * has something to merge and noise up to the density, auto tiled */
+static void write_grid_layer(FILE *out, gen_opts *opts, int i)
+{
+	int w = opts->grid_w, h = opts->grid_h;
+	int *cells = calloc(w * h, sizeof(int));
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int border = x == 0 || y == 0 || x == w - 1 || y == h - 1;
+			cells[y * w + x] = border ? 1 : 0;
+		}
+	}
+	int filled = 0;
+	int target = w * h * opts->density / 100;
+	for (int r = 0; r < 64 && filled < target / 2; r++) {
+		int rw = 1 + rng() % (w / 4 + 1), rh = 1 + rng() % (h / 4 + 1);
+		int rx = rng() % w, ry = rng() % h;
+		int v = 1 + rng() % 3;
+		for (int y = ry; y < ry + rh && y < h; y++) {
+			for (int x = rx; x < rx + rw && x < w; x++) {
+				filled += cells[y * w + x] == 0;
+				cells[y * w + x] = v;
+			}
+		}
+	}
+	for (int k = 0; k < w * h; k++) {
+		if (cells[k] == 0 && (int)(rng() % 100) < opts->density / 2) {
+			cells[k] = 1 + rng() % 3;
+		}
+	}
+
+	fprintf(out,
+		"{\"__identifier\": \"Collisions\", \"__type\": \"IntGrid\", "
+		"\"__cWid\": %d, \"__cHei\": %d, \"__gridSize\": %d, "
+		"\"__tilesetDefUid\": 1, \"__tilesetRelPath\": \"gfx/tiles.png\", "
+		"\"iid\": \"li-c-%d\", \"gridTiles\": [], \"entityInstances\": [],\n"
+		"\"intGridCsv\": [",
+		w, h, TILE, i);
+	for (int k = 0; k < w * h; k++) {
+		fprintf(out, k > 0 ? ",%d" : "%d", cells[k]);
+	}
+	fprintf(out, "],\n\"autoLayerTiles\": [");
+	int first = 1;
+	for (int k = 0; k < w * h; k++) {
+		if (cells[k] == 0)
+			continue;
+		int t = cells[k] * 16 + rng() % 16;
+		fprintf(out,
+			"%s{\"px\": [%d, %d], \"src\": [%d, %d], \"f\": %u, "
+			"\"t\": %d, \"d\": [0], \"a\": 1}",
+			first ? "" : ",\n", k % w * TILE, k / w * TILE,
+			t % 16 * TILE, t / 16 * TILE, rng() % 4, t);
+		first = 0;
+	}
+	fprintf(out, "]}");
+	free(cells);
+}
+
+static void write_tile_layer(FILE *out, gen_opts *opts, int i)
+{
+	int w = opts->grid_w, h = opts->grid_h;
+	fprintf(out,
+		"{\"__identifier\": \"Deco\", \"__type\": \"Tiles\", "
+		"\"__cWid\": %d, \"__cHei\": %d, \"__gridSize\": %d, "
+		"\"__tilesetDefUid\": 1, \"__tilesetRelPath\": \"gfx/tiles.png\", "
+		"\"iid\": \"li-d-%d\", \"autoLayerTiles\": [], \"intGridCsv\": [], "
+		"\"entityInstances\": [],\n\"gridTiles\": [",
+		w, h, TILE, i);
+	int first = 1;
+	for (int k = 0; k < w * h; k++) {
+		if ((int)(rng() % 100) >= opts->density)
+			continue;
+		int t = rng() % 256;
+		fprintf(out,
+			"%s{\"px\": [%d, %d], \"src\": [%d, %d], \"f\": %u, "
+			"\"t\": %d, \"d\": [%d], \"a\": 1}",
+			first ? "" : ",\n", k % w * TILE, k / w * TILE,
+			t % 16 * TILE, t / 16 * TILE, rng() % 4, t, k);
+		first = 0;
+	}
+	fprintf(out, "]}");
+}
+
+static void write_ent_layer(FILE *out, gen_opts *opts, int i)
+{
+	static const char *types[] = { "Enemy", "Chest", "Spawner", "Door" };
+	int w = opts->grid_w, h = opts->grid_h;
+	int cols = columns(opts);
+	int wx = i % cols * w * TILE, wy = i / cols * h * TILE;
+	fprintf(out,
+		"{\"__identifier\": \"Entities\", \"__type\": \"Entities\", "
+		"\"__cWid\": %d, \"__cHei\": %d, \"__gridSize\": %d, "
+		"\"__tilesetDefUid\": null, \"__tilesetRelPath\": null, "
+		"\"iid\": \"li-e-%d\", \"gridTiles\": [], \"autoLayerTiles\": [], "
+		"\"intGridCsv\": [],\n\"entityInstances\": [",
+		w, h, TILE, i);
+	for (int e = 0; e < opts->ents; e++) {
+		int type = rng() % 4;
+		int cx = rng() % w, cy = rng() % h;
+		fprintf(out,
+			"%s{\"__identifier\": \"%s\", \"__grid\": [%d, %d], "
+			"\"__pivot\": [0.5, 1], \"__tags\": [], \"__tile\": null, "
+			"\"__smartColor\": \"#BE4A2F\", \"iid\": \"ent-%d-%d\", "
+			"\"width\": %d, \"height\": %d, \"defUid\": %d, "
+			"\"px\": [%d, %d], \"__worldX\": %d, \"__worldY\": %d,\n"
+			"\"fieldInstances\": ",
+			e > 0 ? ",\n" : "", types[type], cx, cy, i, e, TILE, TILE,
+			10 + type, cx * TILE, cy * TILE, wx + cx * TILE,
+			wy + cy * TILE);
+		write_fields(out, opts->fields, e);
+		fputc('}', out);
+	}
+	fprintf(out, "]}");
+}
+
+/** \brief count fields named f0, f1.. cycling through the common types */
+static void write_fields(FILE *out, int count, int seed)
+{
+	fputc('[', out);
+	for (int f = 0; f < count; f++) {
+		fprintf(out, "%s{\"__identifier\": \"f%d\", ", f > 0 ? ", " : "",
+			f);
+		switch (f % 6) {
+		case 0:
+			fprintf(out, "\"__type\": \"Int\", \"__value\": %d", seed + f);
+			break;
+		case 1:
+			fprintf(out, "\"__type\": \"Float\", \"__value\": %d.5",
+				seed);
+			break;
+		case 2:
+			fprintf(out, "\"__type\": \"String\", \"__value\": \"s%d\"",
+				seed);
+			break;
+		case 3:
+			fprintf(out, "\"__type\": \"Bool\", \"__value\": %s",
+				seed % 2 ? "true" : "false");
+			break;
+		case 4:
+			fprintf(out,
+				"\"__type\": \"Point\", "
+				"\"__value\": {\"cx\": %d, \"cy\": %d}",
+				seed % 7, seed % 5);
+			break;
+		case 5:
+			fprintf(out,
+				"\"__type\": \"Array<Int>\", \"__value\": [1, 2, %d]",
+				seed);
+			break;
+		}
+		fprintf(out, ", \"__tile\": null, \"defUid\": %d, "
+			     "\"realEditorValues\": []}",
+			100 + f);
+	}
+	fputc(']', out);
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-l levels] [-w grid_w] [-h grid_h] [-d density%%] "
+		"[-e ents] [-f fields] [-m] [-s seed] dir\n"
+		"  -m writes every level to its own .ldtkl file\n",
+		name);
+}
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bunarena.h"
+
+static bunarena_chunk *bunarena_chunk_create(usize cap, bunarena_chunk *next);
+static usize bunarena_align(usize size);
+
+bunarena *bunarena_create(usize chunk_size)
+{
+	bunarena *arena = malloc(sizeof(bunarena));
+	arena->chunk_size = chunk_size > 0 ? chunk_size : BARENA_D_CHUNK;
+	arena->head = bunarena_chunk_create(arena->chunk_size, NULL);
+	arena->allocs = 0;
+	arena->bytes = 0;
+	return arena;
+}
+
+void bunarena_destroy(bunarena *arena)
+{
+	bunarena_chunk *chunk = arena->head;
+	while (chunk != NULL) {
+		bunarena_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	free(arena);
+}
+
+void *bunarena_alloc(bunarena *arena, usize size)
+{
+	size = bunarena_align(size);
+	bunarena_chunk *chunk = arena->head;
+	if (chunk->cap - chunk->used < size) {
+		usize cap = size > arena->chunk_size ? size : arena->chunk_size;
+		chunk = bunarena_chunk_create(cap, arena->head);
+		arena->head = chunk;
+	}
+
+	chunk->last = chunk->used;
+	chunk->used += size;
+	arena->allocs++;
+	arena->bytes += size;
+	return chunk->data + chunk->last;
+}
+
+void *bunarena_calloc(bunarena *arena, usize size)
+{
+	void *ptr = bunarena_alloc(arena, size);
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+void *bunarena_realloc(bunarena *arena, void *ptr, usize old_size,
+		       usize new_size)
+{
+	if (ptr == NULL)
+		return bunarena_alloc(arena, new_size);
+	if (new_size <= old_size)
+		return ptr;
+
+	bunarena_chunk *chunk = arena->head;
+	if ((u8 *)ptr == chunk->data + chunk->last &&
+	    chunk->cap - chunk->last >= bunarena_align(new_size)) {
+		arena->bytes += chunk->last + bunarena_align(new_size) - chunk->used;
+		chunk->used = chunk->last + bunarena_align(new_size);
+		return ptr;
+	}
+
+	void *new_ptr = bunarena_alloc(arena, new_size);
+	memcpy(new_ptr, ptr, old_size);
+	return new_ptr;
+}
+
+char *bunarena_strdup(bunarena *arena, const char *str)
+{
+	if (str == NULL)
+		return NULL;
+	usize len = strlen(str) + 1;
+	char *dst = bunarena_alloc(arena, len);
+	memcpy(dst, str, len);
+	return dst;
+}
+
+void bunarena_merge(bunarena *dst, bunarena *src)
+{
+	// the chunks go behind the head of dst, so it keeps allocating
+	// from the same chunk
+	bunarena_chunk *tail = src->head;
+	while (tail->next != NULL) {
+		tail = tail->next;
+	}
+	tail->next = dst->head->next;
+	dst->head->next = src->head;
+	dst->allocs += src->allocs;
+	dst->bytes += src->bytes;
+	free(src);
+}
+
+/** \brief allocates a chunk that can hold cap bytes and links it to next */
+static bunarena_chunk *bunarena_chunk_create(usize cap, bunarena_chunk *next)
+{
+	bunarena_chunk *chunk = malloc(sizeof(bunarena_chunk) + cap);
+	chunk->next = next;
+	chunk->cap = cap;
+	chunk->used = 0;
+	chunk->last = 0;
+	return chunk;
+}
+
+/** \brief rounds size up to a multiple of BARENA_ALIGN */
+static usize bunarena_align(usize size)
+{
+	return (size + BARENA_ALIGN - 1) & ~(usize)(BARENA_ALIGN - 1);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "buntypes.h"
+
+#define BARENA_D_CHUNK 65536
+#define BARENA_ALIGN 16
+
+typedef struct bunarena_chunk {
+	struct bunarena_chunk *next; 		/**< the previous chunk, chunks are freed from newest to oldest */
+	usize cap; 				/**< the number of bytes the chunk can hold */
+	usize used; 				/**< the number of bytes already handed out */
+	usize last; 				/**< offset of the last allocation, so it can grow in place */
+	u8 data[]; 				/**< the memory handed out by the arena, the header is 32 bytes so it stays aligned */
+} bunarena_chunk;
+
+typedef struct bunarena {
+	bunarena_chunk *head; 			/**< the chunk allocations are taken from */
+	usize chunk_size; 			/**< the size of new chunks, bigger allocations get a chunk of their own */
+	usize allocs; 				/**< the number of allocations handed out */
+	usize bytes; 				/**< their size in bytes, aligned */
+} bunarena;
+
+/** \brief creates an arena, memory is taken from it in chunks and only given back by bunarena_destroy 
+ * \param chunk_size the size in bytes of each chunk, 0 uses BARENA_D_CHUNK
+ * \returns bunarena the created arena */
+bunarena *bunarena_create(usize chunk_size);
+
+/** \brief free's every chunk of the arena and the arena itself, 
+ * every pointer taken from it becomes invalid 
+ * \param arena the arena to be destroyed */
+void bunarena_destroy(bunarena *arena);
+
+/** \brief gets size bytes from the arena, aligned to BARENA_ALIGN 
+ * \param arena the arena the memory is taken from
+ * \param size the size in bytes of the allocation
+ * \returns ptr to the memory, it's not zeroed */
+void *bunarena_alloc(bunarena *arena, usize size);
+
+/** \brief same as bunarena_alloc, but sets the memory to 0 */
+void *bunarena_calloc(bunarena *arena, usize size);
+
+/** \brief grows an allocation of the arena, in place if it was the last one made, 
+ * otherwise the contents are copied into a new allocation 
+ * \param arena the arena ptr was taken from
+ * \param ptr NULL or the allocation to grow
+ * \param old_size the size ptr was allocated with
+ * \param new_size the new size in bytes 
+ * \returns ptr to the grown allocation */
+void *bunarena_realloc(bunarena *arena, void *ptr, usize old_size,
+		       usize new_size);
+
+/** \brief copies str into the arena 
+ * \returns ptr to the copy, or NULL if str is NULL */
+char *bunarena_strdup(bunarena *arena, const char *str);
+
+/** \brief moves every chunk of src into dst and destroys src, 
+ * pointers taken from src stay valid and are now freed with dst 
+ * \param dst the arena that takes the chunks 
+ * \param src the arena to be emptied, it can't be used afterwards */
+void bunarena_merge(bunarena *dst, bunarena *src);
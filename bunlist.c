@@ -3,8 +3,9 @@
 #include <string.h>
 #include "bunlist.h"
 
-static void bunlist_resize(bunlist *arr, usize newcap);
+static bool bunlist_resize(bunlist *arr, usize newcap);
 static void bunlist_chk_resize(bunlist *arr);
+static usize bunlist_next_cap(bunlist *arr);
 static bool bunlist_chk_index(bunlist *arr, usize i);
 
 bunlist *bunlist_create(usize isize, usize cap,
@@ -18,6 +19,7 @@ bunlist *bunlist_create_ex(usize isize, usize cap, u32 incr, bool mult,
 			 bool subarr, void (*free_fn)(usize i, void *data))
 {
 	bunlist *arr = malloc(sizeof(bunlist));
+	arr->arena = NULL;
 	arr->subarr = subarr;
 	arr->isize = isize;
 	arr->len = 0;
@@ -31,6 +33,24 @@ bunlist *bunlist_create_ex(usize isize, usize cap, u32 incr, bool mult,
 	return arr;
 }
 
+bunlist *bunlist_create_arena(bunarena *arena, usize isize, usize cap,
+			      void (*free_fn)(usize i, void *data))
+{
+	bunlist *arr = bunarena_alloc(arena, sizeof(bunlist));
+	arr->arena = arena;
+	arr->subarr = false;
+	arr->isize = isize;
+	arr->len = 0;
+	arr->cap = 0;
+	arr->incr = BARR_D_INCR;
+	arr->mult = BARR_D_MULT;
+	arr->items = NULL;
+	arr->free_fn = free_fn;
+	bunlist_resize(arr, cap);
+
+	return arr;
+}
+
 usize bunlist_append(bunlist *arr, void *item)
 {
 	bunlist_chk_resize(arr);
@@ -41,6 +61,40 @@ usize bunlist_append(bunlist *arr, void *item)
 	return arr->len - 1;
 }
 
+usize bunlist_append_n(bunlist *arr, void *items, usize n)
+{
+	usize i = arr->len;
+	if (n == 0) {
+		return i;
+	}
+	if (arr->cap < arr->len + n) {
+		// grow like append would, unless that's still too small
+		usize newcap = bunlist_next_cap(arr);
+		if (!bunlist_reserve(arr, newcap > arr->len + n ?
+						  newcap :
+						  arr->len + n))
+			return BARR_E_FULL;
+	}
+
+	memcpy(arr->items + (arr->len * arr->isize), items, n * arr->isize);
+	arr->len += n;
+
+	return i;
+}
+
+usize bunlist_extend(bunlist *dst, bunlist *src)
+{
+	return bunlist_append_n(dst, src->items, src->len);
+}
+
+bool bunlist_reserve(bunlist *arr, usize cap)
+{
+	if (arr->cap >= cap) {
+		return true;
+	}
+	return bunlist_resize(arr, cap);
+}
+
 usize bunlist_append_free(bunlist *arr, void *item)
 {
 	usize i = bunlist_append(arr, item);
@@ -113,8 +167,13 @@ bool bunlist_destroy(bunlist *arr)
 		}
 	}
 
-	free(arr->items);
-	free(arr);
+	if (arr->arena == NULL) {
+		// a subarray points into memory it does not own
+		if (!arr->subarr) {
+			free(arr->items);
+		}
+		free(arr);
+	}
 
 	return true;
 }
@@ -137,12 +196,16 @@ void *bunlist_get(bunlist *arr, usize i)
 
 void bunlist_cpy(bunlist *dst_arr, bunlist *src_arr)
 {
+	if (dst_arr->arena != NULL) {
+		// the old items can't be given back, don't copy them over
+		dst_arr->items = NULL;
+		dst_arr->cap = 0;
+	}
 	dst_arr->isize = src_arr->isize;
 	dst_arr->len = src_arr->len;
-	dst_arr->cap = src_arr->cap;
 	dst_arr->incr = src_arr->incr;
 	dst_arr->mult = src_arr->mult;
-	bunlist_resize(dst_arr, dst_arr->cap);
+	bunlist_resize(dst_arr, src_arr->cap);
 	memcpy(dst_arr->items, src_arr->items, src_arr->isize * src_arr->len);
 }
 
@@ -203,27 +266,40 @@ bunlist *bunlist_subarr(bunlist *arr, usize start, usize end, bool clone)
 static void bunlist_chk_resize(bunlist *arr)
 {
 	if (arr->cap <= arr->len) {
-		if (arr->mult) {
-			//roundup to avoid errors
-			usize newcapacity =
-				(usize)(arr->cap * (arr->incr * 0.1));
-
-			bunlist_resize(arr, newcapacity);
-		} else {
-			usize newcapacity = arr->cap + arr->incr;
-			bunlist_resize(arr, newcapacity);
-		}
+		bunlist_resize(arr, bunlist_next_cap(arr));
 	}
 }
 
+/** \brief the capacity the array grows to once it's full, 
+ * always at least one more item so empty or tiny arrays grow too */
+static usize bunlist_next_cap(bunlist *arr)
+{
+	usize newcap = arr->mult ? arr->cap * arr->incr / 10 :
+				   arr->cap + arr->incr;
+	return newcap > arr->cap ? newcap : arr->cap + 1;
+}
+
 /** \brief Updates the array len and reallocs the memory to fit the new capacity */
-static void bunlist_resize(bunlist *arr, usize newcap)
+static bool bunlist_resize(bunlist *arr, usize newcap)
 {
-	if (!arr->subarr) {
-		arr->cap = newcap;
-		void *items = realloc(arr->items, arr->isize * arr->cap);
-		arr->items = items;
+	if (arr->subarr) {
+		return false;
 	}
+	void *items;
+	if (arr->arena != NULL) {
+		items = bunarena_realloc(arr->arena, arr->items,
+					 arr->isize * arr->cap,
+					 arr->isize * newcap);
+	} else {
+		items = realloc(arr->items, arr->isize * newcap);
+	}
+	// on failure the old items are still there, keep them
+	if (items == NULL && arr->isize * newcap > 0) {
+		return false;
+	}
+	arr->items = items;
+	arr->cap = newcap;
+	return true;
 }
 
 /** \brief Returns true if the index is valid.
@@ -1,8 +1,10 @@
 #pragma once
 #include "buntypes.h"
+#include "bunarena.h"
 
-#define BARR_D_INCR 15
-#define BARR_D_MULT false
+#define BARR_D_INCR 20 /**< with BARR_D_MULT the capacity doubles on every resize */
+#define BARR_D_MULT true
+#define BARR_E_FULL ((usize)-1) /**< returned instead of an index when the array can't grow */
 
 
 typedef struct bunlist {
@@ -14,6 +16,7 @@ typedef struct bunlist {
 	bool mult; 				/**< percentage - if true the increase value will be used as a multiplyer of the array capacity: newcap = cap * (incr/10) */
 	bool subarr; 				/**< set to true if this is a subarray */
 	void (*free_fn)( usize i, void *itm); 	/**< NULL or function to be called on item removal */
+	bunarena *arena; 			/**< NULL or the arena the list and its items are allocated from */
 
 } bunlist;
 
@@ -37,7 +40,18 @@ bunlist *bunlist_create(usize isize, usize cap,
 bunlist *bunlist_create_ex(usize isize, usize cap, u32 incr, bool mult,
 			 bool subarr, void (*free_fn)(usize i, void *itm));
 
+/** \brief creates an dynamic array inside of an arena, the list and its items 
+ * are taken from the arena and only released when the arena is destroyed 
+ * \param arena the arena the memory is taken from
+ * \param isize The size in bytes of each item,
+ * \param cap The initial capacity of the array,
+ * \param free_fn NULL or a pointer to a callback function that's called on items when they are removed
+ * \returns bunlist the created array */
+bunlist *bunlist_create_arena(bunarena *arena, usize isize, usize cap,
+			      void (*free_fn)(usize i, void *itm));
+
 /** \brief Destroys the array, also calls the free_fn passed in bunlist_create in each item, if it's not NULL. 
+ * arrays from an arena only call free_fn, their memory is released with the arena 
  * \param arr array to be destroyed
  * \returns bool true if it worked, false if an error happened 
  * \sa bunlist_clear */
@@ -49,6 +63,27 @@ bool bunlist_destroy(bunlist *arr);
  * \returns i index of the appended item */
 usize bunlist_append(bunlist *arr, void *itm);
 
+/** \brief Appends n items to bunlist with a single copy, growing it at most once 
+ * \param arr array where the items will be appended to
+ * \param itms pointer to n contiguous items
+ * \param n the number of items to append
+ * \returns i index of the first appended item, or BARR_E_FULL if arr couldn't grow, 
+ * because it's a subarray or the allocation failed. nothing is appended then */
+usize bunlist_append_n(bunlist *arr, void *itms, usize n);
+
+/** \brief Appends every item of src to dst, see bunlist_append_n 
+ * \param dst the array the items are appended to
+ * \param src the array the items are copied from, its items must be the same size
+ * \returns i index in dst of the first appended item, or BARR_E_FULL */
+usize bunlist_extend(bunlist *dst, bunlist *src);
+
+/** \brief makes sure the array can hold cap items without resizing 
+ * \param arr the array to be resized
+ * \param cap the number of items the array must be able to hold
+ * \returns bool true if it worked, false if arr is a subarray that can't hold cap items 
+ * or the allocation failed, arr is left as it was */
+bool bunlist_reserve(bunlist *arr, usize cap);
+
 /** \brief Appends item to bunlist by copying, and then runs free(itm) 
  * \param arr array where itm will be appended to
  * \param itm item to be appended to array
@@ -2,40 +2,134 @@
 * reads .json ldtk levels and returns  
 * it in the form of a filled ldtk_Level struct */
 
+// clock_gettime for the load stats, strict c2x leaves it out
+#define _POSIX_C_SOURCE 200809L
 #include <string.h>
-#include <libgen.h> // provides basename()
+#include <pthread.h>
+#include <unistd.h>
 #include <stdio.h>
-#include "ldtk.h"
+#include <time.h>
+#include "ldtk_private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LDTK_X86
+#endif
+
+/** a horizontal run of cells with the same accepted intgrid value */
+typedef struct ldtk_run {
+	i32 x, w, value;
+} ldtk_run;
+
+/** a rectangle grid_to_walls_rle is still growing down, with the whole
+ * intgrid value since ldtk_wall only keeps its low byte */
+typedef struct ldtk_open_wall {
+	ldtk_rect bb;
+	i32 value;
+} ldtk_open_wall;
+
+/** a layer instance decoded on its own by get_layers_parallel */
+typedef struct layer_task {
+	json_object *json;
+	ldtk_lvl part; // a copy of the level that collects what the layer adds
+	ldtk_stats stats; // the layer phases of part, added to the level in merge_layer
+} layer_task;
+
+typedef struct layer_pool {
+	layer_task *tasks;
+	u32 len;
+	u32 next; // next task nobody took yet, taken with an atomic add
+} layer_pool;
 
 static i32 json_get_i32(json_object *obj, char *key);
 static void *json_get_ptr(json_object *obj, char *key);
 static char *json_get_str(json_object *obj, char *key);
-
-static json_object *get_lvl_json(char *name);
-static void get_intgrid(ldtk_lvl *lvl, json_object *gridLayer);
+static char *json_lvl_str(ldtk_lvl *lvl, json_object *obj, char *key);
+static char *lvl_strdup(ldtk_lvl *lvl, const char *str);
+static void *lvl_alloc(ldtk_lvl *lvl, usize size);
+static void *lvl_calloc(ldtk_lvl *lvl, usize size);
+static ldtk_fields *lvl_fields(ldtk_lvl *lvl, json_object *field_instances);
+static bunlist *lvl_list(ldtk_lvl *lvl, usize isize, usize cap,
+			 void (*free_fn)(usize i, void *itm));
+
+static ldtk_lvl *load_lvl(ldtk_ctx *ctx, char *lname, ldtk_stats *stats);
+static json_object *get_lvl_json(ldtk_ctx *ctx, char *name,
+				 ldtk_stats *stats);
+static char *read_file(char *path, usize *len);
+static u32 skim_lvl_ranges(char *buf, usize len, bunlist *lvls);
+static void get_intgrid(ldtk_lvl *lvl, json_object *gridLayer, u32 z);
 static void get_tile(ldtk_lvl *lvl, bunlist *tiles, json_object *tile_i);
-static void get_tilelayer(ldtk_lvl *lvl, json_object *Layer, char *tilekey);
-static void get_ents(ldtk_lvl *lvl, json_object *entitiyLayer);
-static void get_ngbrs(ldtk_lvl *lvl, json_object *parsed_json);
-
-static void arr_to_grid(i32 *csvgrid, i32 lenx, i32 leny, i32 grid[lenx][leny]);
-static void grid_to_walls(i32 lenx, i32 leny, i32 grid[lenx][leny],
-			  ldtk_lvl *lvl);
-static void grid_to_walls_greedy(i32 lenx, i32 leny, i32 grid[lenx][leny],
-				 ldtk_lvl *lvl);
-static i32 expand_y(ldtk_rect row, i32 lenx, i32 leny, i32 grid[lenx][leny]);
-static bool expand_x(ldtk_rect row, i32 lenx, i32 leny,
-		     i32 intgrid[lenx][leny]);
+static ldtk_tile_cols *get_tile_cols(ldtk_lvl *lvl, json_object *tiles);
+static void get_tilelayer(ldtk_lvl *lvl, json_object *Layer, char *tilekey,
+			  u32 z);
+static void get_ents(ldtk_lvl *lvl, json_object *entitiyLayer, u32 z);
+static void get_ngbrs(ldtk_lvl *lvl, ldtk_lvl_info *info);
+static bool get_layer(ldtk_lvl *lvl, json_object *layer, u32 z);
+static void get_layers_parallel(ldtk_lvl *lvl, json_object *layers, u32 len);
+static void *layer_main(void *arg);
+static void merge_layer(ldtk_lvl *lvl, ldtk_lvl *part);
+static void build_lvl_index(ldtk_sys *ldtk_sys, json_object *json);
+static u32 find_lvl(ldtk_sys *ldtk_sys, const char *key, bool by_name);
+static void free_lvl_info(usize i, void *itm);
+static bunlist *get_ent_defs(json_object *prj);
+static void free_ent_def(usize i, void *itm);
+static void free_tag(usize i, void *itm);
+static i32 cmp_ent_def(const void *a, const void *b);
+static ldtk_ent_def *find_ent_def(ldtk_ctx *ctx, i32 uid);
+static void intern_ents(ldtk_ctx *ctx, ldtk_lvl *lvl);
+static bunlist *get_tilesets(json_object *prj);
+static void free_tileset(usize i, void *itm);
+static i32 find_tileset(ldtk_ctx *ctx, i32 uid);
+static ldtk_lvl *build_lvl_queries(ldtk_ctx *ctx, ldtk_lvl *lvl);
+static void build_lvl_composites(ldtk_ctx *ctx, ldtk_lvl *lvl);
+static bool has_tileset_images(ldtk_ctx *ctx);
+static void free_layer_content(ldtk_lvl *lvl, ldtk_layer *layer);
+static void own_walls(ldtk_lvl *lvl);
+static void own_grid(ldtk_lvl *lvl, ldtk_grid *grid);
+static u32 mesh_grid(ldtk_lvl *lvl, ldtk_grid *grid, u32 z, i32 ox, i32 oy);
+static bool rect_overlap(ldtk_rect a, ldtk_rect b);
+static void walls_in_area(ldtk_lvl *lvl, ldtk_rect area, bunlist *out);
+static void remove_wall(ldtk_lvl *lvl, u32 i);
+static i32 cmp_idx_desc(const void *a, const void *b);
+static u64 now_ns(void);
+static u64 stats_start(ldtk_stats *stats);
+static void stats_end(ldtk_stats *stats, LDTK_PHASE phase, u64 start);
+static void stats_alloc(ldtk_stats *stats, usize size);
+static void count_lvl_stats(ldtk_lvl *lvl, ldtk_stats *stats);
+
+static void arr_to_grid(json_object *csv, ldtk_grid *grid);
+static void grid_to_walls(ldtk_grid *grid, ldtk_lvl *lvl);
+static void grid_to_walls_greedy(ldtk_grid *grid, ldtk_lvl *lvl);
+static void grid_to_walls_rle(ldtk_grid *grid, ldtk_lvl *lvl);
+static void put_open_wall(ldtk_lvl *lvl, ldtk_open_wall *open);
+static u32 grid_row_runs(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx);
+static u32 row_runs_scalar(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx);
+static u32 row_runs_tail(i32 *row, i32 w, i32 x, i32 start, ldtk_run *runs,
+			 u32 n, ldtk_ctx *ctx);
+#ifdef LDTK_X86
+static u32 row_runs_sse2(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx);
+static u32 row_runs_avx2(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx);
+#endif
+static void pick_row_runs(void);
+static i32 expand_y(ldtk_rect row, ldtk_grid *grid);
+static bool expand_x(ldtk_rect row, ldtk_grid *grid);
 static void free_neighbours(usize i, void *itm);
 static void free_layers(usize i, void *itm);
 static void free_ents(usize i, void *itm);
 static bool chk_flag(i32 flag, i32 bit);
-static bool ldtk_grid_value_accepted(u32 value);
-
-static ldtk_sys sys;
-static u32 z = 0;
-
-enum : u16 {
+static bool ldtk_grid_value_accepted(ldtk_ctx *ctx, u32 value);
+static void init_ctx(ldtk_ctx *ctx, u32 tl_size, char *prj_name,
+		     char *prj_dir, LDTK_FLAGS flags);
+static void destroy_ctx(ldtk_ctx *ctx);
+
+/** the context used by the functions without a ctx parameter */
+static ldtk_ctx sys;
+/** run extraction kernel, picked for the cpu once by the first init */
+static u32 (*row_runs)(i32 *row, i32 w, ldtk_run *runs,
+		       ldtk_ctx *ctx) = row_runs_scalar;
+static pthread_once_t row_runs_once = PTHREAD_ONCE_INIT;
+
+enum : u32 {
 	LDTK_SINGLE_FILE = 0x00000001, /**< Single file contains all levels*/
 	LDTK_MULTI_FILE = 0x00000002, /**< Each level has their file */
 	LDTK_PNG_LAYER = 0x00000004, /**< one png for each layer of each level*/
@@ -50,7 +144,27 @@ enum : u16 {
 
 void ldtk_init(u32 tl_size, char *prj_name, char *prj_dir, LDTK_FLAGS flags)
 {
-	ldtk_sys ldtk_sys;
+	init_ctx(&sys, tl_size, prj_name, prj_dir, flags);
+}
+
+ldtk_ctx *ldtk_init_ctx(u32 tl_size, char *prj_name, char *prj_dir,
+			LDTK_FLAGS flags)
+{
+	ldtk_ctx *ctx = malloc(sizeof(ldtk_ctx));
+	init_ctx(ctx, tl_size, prj_name, prj_dir, flags);
+	return ctx;
+}
+
+ldtk_ctx *ldtk_get_ctx(void)
+{
+	return &sys;
+}
+
+/** \brief reads the project settings and builds the level index into ctx */
+static void init_ctx(ldtk_ctx *ctx, u32 tl_size, char *prj_name,
+		     char *prj_dir, LDTK_FLAGS flags)
+{
+	ldtk_sys ldtk_sys = { 0 };
 	ldtk_sys.tl_size = tl_size;
 	ldtk_sys.prj_dir = prj_dir;
 	ldtk_sys.prj_name = prj_name;
@@ -62,9 +176,15 @@ void ldtk_init(u32 tl_size, char *prj_name, char *prj_dir, LDTK_FLAGS flags)
 
 	if (chk_flag(flags, LDTK_EXTENSION_JSON))
 		strcat(jsonpath, ".json");
-	else if (chk_flag(flags, LDTK_EXTENSION_LDTK))
+	else
 		strcat(jsonpath, ".ldtk");
-	json_object *json = json_object_from_file(jsonpath);
+
+	// the raw text is kept around in single file mode, see get_lvl_json
+	usize prj_len = 0;
+	char *prj_buf = read_file(jsonpath, &prj_len);
+	json_tokener *tok = json_tokener_new();
+	json_object *json = json_tokener_parse_ex(tok, prj_buf, prj_len);
+	json_tokener_free(tok);
 
 	char *layout = json_get_str(json, "worldLayout");
 	if (strcmp(layout, "gridvania") == 0) {
@@ -104,82 +224,204 @@ void ldtk_init(u32 tl_size, char *prj_name, char *prj_dir, LDTK_FLAGS flags)
 		ldtk_sys.flags |= LDTK_PNG_LAYER;
 	}
 	free(image_export);
+	build_lvl_index(&ldtk_sys, json);
+	ldtk_sys.ent_defs = get_ent_defs(json);
+	ldtk_sys.tilesets = get_tilesets(json);
 	json_object_put(json);
 
-	sys = ldtk_sys;
-	sys.ignored_intgrid_values = bunlist_create(sizeof(u32), 10, NULL);
-	ldtk_ignore_intgrid_value(0);
+	ldtk_sys.prj_buf = NULL;
+	if (chk_flag(ldtk_sys.flags, LDTK_SINGLE_FILE)) {
+		u32 found = skim_lvl_ranges(prj_buf, prj_len, ldtk_sys.lvls);
+		if (found == ldtk_sys.lvls->len) {
+			ldtk_sys.prj_buf = prj_buf;
+			prj_buf = NULL;
+		}
+	}
+	free(prj_buf);
+
+	*ctx = ldtk_sys;
+	ctx->part_size = tl_size * 8;
+	ctx->chunk_size = 32;
+	ctx->ignored_intgrid_values = bunlist_create(sizeof(u32), 10, NULL);
+	ldtk_ignore_intgrid_value_ctx(ctx, 0);
+
+	pthread_once(&row_runs_once, pick_row_runs);
 }
 
 void ldtk_free(void)
 {
-	bunlist_destroy(sys.ignored_intgrid_values);
+	// the loader may still be reading the project,
+	// the jobs of other contexts keep it running
+	ldtk_prefetch_clear_ctx(&sys);
+	ldtk_prefetch_stop_idle();
+	destroy_ctx(&sys);
+}
+
+void ldtk_free_ctx(ldtk_ctx *ctx)
+{
+	ldtk_prefetch_clear_ctx(ctx);
+	ldtk_prefetch_stop_idle();
+	destroy_ctx(ctx);
+	free(ctx);
+}
+
+/** \brief frees everything init_ctx allocated, but not ctx itself */
+static void destroy_ctx(ldtk_ctx *ctx)
+{
+	bunlist_destroy(ctx->ignored_intgrid_values);
+	bunlist_destroy(ctx->lvls);
+	bunlist_destroy(ctx->ent_defs);
+	bunlist_destroy(ctx->tilesets);
+	free(ctx->iid_map);
+	free(ctx->name_map);
+	free(ctx->prj_buf);
+	if (ctx->baked != NULL) {
+		ldtk_baked_close(ctx->baked);
+	}
 }
 
 void ldtk_get_lvl_name(char *iid, char *dst)
 {
-	char path[300] = "";
-	strcat(path, sys.prj_dir);
-	strcat(path, sys.prj_name);
+	ldtk_get_lvl_name_ctx(&sys, iid, dst);
+}
 
-	i32 flags = sys.flags;
+void ldtk_get_lvl_name_ctx(ldtk_ctx *ctx, char *iid, char *dst)
+{
+	ldtk_lvl_info *info = ldtk_get_lvl_info_ctx(ctx, iid);
+	if (info != NULL) {
+		strcpy(dst, info->identifier);
+	}
+}
 
-	if (chk_flag(flags, LDTK_EXTENSION_JSON))
-		strcat(path, ".json");
-	else if (chk_flag(flags, LDTK_EXTENSION_LDTK))
-		strcat(path, ".ldtk");
+bunlist *ldtk_get_lvl_index(void)
+{
+	return sys.lvls;
+}
 
-	json_object *json = json_object_from_file(path);
-	json_object *lvls = json_object_object_get(json, "levels");
-	i32 len = json_object_array_length(lvls);
-	for (i32 i = 0; i < len; i++) {
-		json_object *lvl_i = json_object_array_get_idx(lvls, i);
-		u32 type = json_object_get_type(lvl_i);
+bunlist *ldtk_get_lvl_index_ctx(ldtk_ctx *ctx)
+{
+	return ctx->lvls;
+}
 
-		char *iid_i = json_get_str(lvl_i, "iid");
+ldtk_lvl_info *ldtk_get_lvl_info(char *iid)
+{
+	return ldtk_get_lvl_info_ctx(&sys, iid);
+}
 
-		if (iid == NULL || type == json_type_null)
-			break;
+ldtk_lvl_info *ldtk_get_lvl_info_ctx(ldtk_ctx *ctx, char *iid)
+{
+	u32 i = find_lvl(ctx, iid, false);
+	if (i == 0)
+		return NULL;
+	return bunlist_get(ctx->lvls, i - 1);
+}
 
-		if (strcmp(iid, iid_i) == 0) {
-			char *fpath = json_get_str(lvl_i, "identifier");
-			strcpy(dst, fpath);
-			free(fpath);
-		}
+ldtk_lvl_info *ldtk_get_lvl_info_name(char *name)
+{
+	return ldtk_get_lvl_info_name_ctx(&sys, name);
+}
 
-		free(iid_i);
-	}
-	json_object_put(json);
+ldtk_lvl_info *ldtk_get_lvl_info_name_ctx(ldtk_ctx *ctx, char *name)
+{
+	u32 i = find_lvl(ctx, name, true);
+	if (i == 0)
+		return NULL;
+	return bunlist_get(ctx->lvls, i - 1);
 }
 
 ldtk_lvl *ldtk_load_lvl(char *lname)
 {
-	json_object *lvl_json = get_lvl_json(lname);
+	return ldtk_load_lvl_ctx(&sys, lname);
+}
+
+ldtk_lvl *ldtk_load_lvl_ctx(ldtk_ctx *ctx, char *lname)
+{
+	if (ctx->stats_fn == NULL)
+		return load_lvl(ctx, lname, NULL);
+
+	ldtk_stats stats = { 0 };
+	u64 start = now_ns();
+	ldtk_lvl *lvl = load_lvl(ctx, lname, &stats);
+	if (lvl == NULL)
+		return NULL;
+	stats.total_ns = now_ns() - start;
+	count_lvl_stats(lvl, &stats);
+	lvl->stats = NULL;
+	ctx->stats_fn(lvl, &stats, ctx->stats_user);
+	return lvl;
+}
+
+/** \brief loads a level from the baked blob or its json, 
+ * timing the phases into stats if it's not NULL */
+static ldtk_lvl *load_lvl(ldtk_ctx *ctx, char *lname, ldtk_stats *stats)
+{
+	if (ctx->baked != NULL) {
+		u32 i = find_lvl(ctx, lname, true);
+		if (i != 0) {
+			u64 start = stats_start(stats);
+			ldtk_lvl *lvl = ldtk_baked_lvl(ctx->baked, i - 1);
+			if (lvl != NULL) {
+				intern_ents(ctx, lvl);
+				lvl->stats = stats;
+			}
+			stats_end(stats, LDTK_PHASE_LEVEL, start);
+			if (stats != NULL) {
+				stats->baked = true;
+			}
+			return build_lvl_queries(ctx, lvl);
+		}
+	}
+
+	json_object *lvl_json = get_lvl_json(ctx, lname, stats);
 
 	if (lvl_json == NULL) {
 		return NULL;
 	}
-	ldtk_lvl *lvl = malloc(sizeof(ldtk_lvl));
-	memset(lvl, 0, sizeof(ldtk_lvl));
+	ldtk_lvl *lvl;
+	if (chk_flag(ctx->flags, LDTK_LEVEL_ARENA)) {
+		bunarena *arena = bunarena_create(0);
+		lvl = bunarena_alloc(arena, sizeof(ldtk_lvl));
+		memset(lvl, 0, sizeof(ldtk_lvl));
+		lvl->arena = arena;
+		if (!chk_flag(ctx->flags, LDTK_LEVEL_DROP_JSON)) {
+			lvl->json_refs = json_object_new_array();
+		}
+	} else {
+		lvl = malloc(sizeof(ldtk_lvl));
+		memset(lvl, 0, sizeof(ldtk_lvl));
+	}
+	stats_alloc(stats, sizeof(ldtk_lvl));
+	lvl->ctx = ctx;
+	lvl->stats = stats;
+	u64 start = stats_start(stats);
 
-	lvl->id = json_get_str(lvl_json, "iid");
-	lvl->bg_tile_path = json_get_str(lvl_json, "bgRelPath");
+	lvl->id = json_lvl_str(lvl, lvl_json, "iid");
+	lvl->bg_tile_path = json_lvl_str(lvl, lvl_json, "bgRelPath");
 
 	lvl->rect.x = json_get_i32(lvl_json, "worldX");
 	lvl->rect.y = json_get_i32(lvl_json, "worldY");
 	lvl->rect.w = json_get_i32(lvl_json, "pxWid");
 	lvl->rect.h = json_get_i32(lvl_json, "pxHei");
 
-	lvl->layers = bunlist_create(sizeof(ldtk_layer), 5, free_layers);
-	lvl->ngbrs = bunlist_create(sizeof(ldtk_ngbr), 6, free_neighbours);
-	lvl->walls = bunlist_create(sizeof(ldtk_wall), 60, NULL);
-
-	lvl->path = malloc(sizeof(char) * 300);
-	ldtk_get_lvl_name(lvl->id, lvl->path);
-	get_ngbrs(lvl, lvl_json);
-
-	lvl->custom_fields = json_object_object_get(lvl_json, "fieldInstances");
-	json_object_get(lvl->custom_fields);
+	lvl->layers = lvl_list(lvl, sizeof(ldtk_layer), 5, free_layers);
+	lvl->ngbrs = lvl_list(lvl, sizeof(ldtk_ngbr), 6, free_neighbours);
+	lvl->walls = lvl_list(lvl, sizeof(ldtk_wall), 60, NULL);
+	lvl->wall_size = ctx->tl_size;
+
+	ldtk_lvl_info *info = ldtk_get_lvl_info_ctx(ctx, lvl->id);
+	lvl->path = lvl_strdup(lvl, info != NULL ? info->identifier : lname);
+	stats_end(stats, LDTK_PHASE_LEVEL, start);
+	start = stats_start(stats);
+	get_ngbrs(lvl, info);
+	stats_end(stats, LDTK_PHASE_NGBRS, start);
+	start = stats_start(stats);
+
+	json_object *field_instances =
+		json_object_object_get(lvl_json, "fieldInstances");
+	lvl->fields = lvl_fields(lvl, field_instances);
+	if (!chk_flag(ctx->flags, LDTK_LEVEL_DROP_JSON)) {
+		lvl->custom_fields = json_object_get(field_instances);
+	}
 
 	// try to get bg_color (from the lvl), if it is null use __bgcolor (from the world)
 	char *hex_color = json_get_str(lvl_json, "bgColor");
@@ -194,32 +436,100 @@ ldtk_lvl *ldtk_load_lvl(char *lname)
 	json_object *layers =
 		json_object_object_get(lvl_json, "layerInstances");
 	i32 layers_len = json_object_array_length(layers);
+	// every layer instance becomes at most one ldtk_layer
+	bunlist_reserve(lvl->layers, layers_len);
+	stats_end(stats, LDTK_PHASE_LEVEL, start);
 
 	// load each layer
-	for (i32 i = 0; i < layers_len; i++) {
-		z = i;
-		json_object *arr_i = json_object_array_get_idx(layers, i);
-		char *layer_str = json_get_str(arr_i, "__type");
-		if (layer_str == NULL)
-			break;
-		if (strcmp(layer_str, "AutoLayer") == 0) {
-			get_tilelayer(lvl, arr_i, "autoLayerTiles");
-		} else if (strcmp(layer_str, "Tiles") == 0) {
-			get_tilelayer(lvl, arr_i, "gridTiles");
-		} else if (strcmp(layer_str, "IntGrid") == 0) {
-			get_tilelayer(lvl, arr_i, "autoLayerTiles");
-			get_intgrid(lvl, arr_i);
-		} else if (strcmp(layer_str, "Entities") == 0) {
-			get_ents(lvl, arr_i);
+	if (chk_flag(ctx->flags, LDTK_LEVEL_PARALLEL_LAYERS)) {
+		get_layers_parallel(lvl, layers, layers_len);
+	} else {
+		for (i32 i = 0; i < layers_len; i++) {
+			json_object *arr_i = json_object_array_get_idx(layers, i);
+			if (!get_layer(lvl, arr_i, i))
+				break;
 		}
-		free(layer_str);
 	}
 
+	// freeing the json is only in total_ns, it's not parsing
 	json_object_put(lvl_json);
 
+	return build_lvl_queries(ctx, lvl);
+}
+
+bool ldtk_load_baked(char *path)
+{
+	return ldtk_load_baked_ctx(&sys, path);
+}
+
+bool ldtk_load_baked_ctx(ldtk_ctx *ctx, char *path)
+{
+	if (ctx->baked != NULL) {
+		ldtk_baked_close(ctx->baked);
+	}
+	ctx->baked = ldtk_baked_open_ctx(ctx, path);
+	return ctx->baked != NULL;
+}
+
+/** \brief builds the spatial structures enabled by the flags */
+static ldtk_lvl *build_lvl_queries(ldtk_ctx *ctx, ldtk_lvl *lvl)
+{
+	if (lvl == NULL)
+		return NULL;
+	u64 start = stats_start(lvl->stats);
+	lvl->ctx = ctx;
+	lvl->ent_index = ldtk_ent_index_build(lvl);
+	if (chk_flag(ctx->flags, LDTK_LEVEL_GRID_PARTITION)) {
+		lvl->part = ldtk_part_build(lvl, ctx->part_size);
+	}
+	if (chk_flag(ctx->flags, LDTK_LEVEL_BVH)) {
+		lvl->bvh = ldtk_bvh_build(lvl);
+	}
+	build_lvl_composites(ctx, lvl);
+	// layers keep their chunks, only new ones get built
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (chk_flag(ctx->flags, LDTK_LEVEL_CHUNKS) &&
+		    layer->type == LDTK_LAYER_TILES && layer->chunks == NULL) {
+			layer->chunks =
+				ldtk_chunks_build(lvl, layer, ctx->chunk_size);
+		}
+	}
+	stats_end(lvl->stats, LDTK_PHASE_QUERIES, start);
 	return lvl;
 }
 
+/** \brief draws the composites the image export mode of the project asks 
+ * for, once the tileset images are loaded. like the chunks, layers keep 
+ * their composite and the level one is drawn from them */
+static void build_lvl_composites(ldtk_ctx *ctx, ldtk_lvl *lvl)
+{
+	if ((ctx->flags & LDTK_PNG_BOTH) == 0 || !has_tileset_images(ctx))
+		return;
+	if (chk_flag(ctx->flags, LDTK_PNG_LAYER)) {
+		for (u32 i = 0; i < lvl->layers->len; i++) {
+			ldtk_layer *layer = bunlist_get(lvl->layers, i);
+			if (layer->type == LDTK_LAYER_TILES &&
+			    layer->composite == NULL) {
+				ldtk_composite_layer(lvl, layer);
+			}
+		}
+	}
+	if (chk_flag(ctx->flags, LDTK_PNG_LEVEL) && lvl->composite == NULL) {
+		ldtk_composite_lvl(lvl);
+	}
+}
+
+static bool has_tileset_images(ldtk_ctx *ctx)
+{
+	for (u32 i = 0; i < ctx->tilesets->len; i++) {
+		ldtk_tileset *ts = bunlist_get(ctx->tilesets, i);
+		if (ts->image != NULL)
+			return true;
+	}
+	return false;
+}
+
 void ldtk_destroy_lvl(ldtk_lvl *lvl)
 {
 	ldtk_destroy_lvl_ex(lvl, 0);
@@ -231,22 +541,53 @@ void ldtk_destroy_lvl_ex(ldtk_lvl *lvl, LDTK_LVL_FLAGS flags)
 
 	if (!chk_flag(flags, LVL_KEEP_FIELDS)) {
 		json_object_put(lvl->custom_fields);
+		if (lvl->arena == NULL) {
+			free(lvl->fields);
+		}
+	}
+	if (lvl->part != NULL) {
+		ldtk_part_destroy(lvl->part);
+	}
+	if (lvl->ent_index != NULL) {
+		ldtk_ent_index_destroy(lvl->ent_index);
+	}
+	if (lvl->bvh != NULL) {
+		ldtk_bvh_destroy(lvl->bvh);
+	}
+	if (lvl->composite != NULL) {
+		ldtk_image_destroy(lvl->composite);
+	}
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer_i = bunlist_get(lvl->layers, i);
+		if (chk_flag(flags, LVL_KEEP_TILES))
+			continue;
+		if (layer_i->chunks != NULL) {
+			ldtk_chunks_destroy(layer_i->chunks);
+		}
+		if (layer_i->composite != NULL) {
+			ldtk_image_destroy(layer_i->composite);
+		}
+	}
+	if (lvl->arena != NULL) {
+		// the level itself lives in the arena, nothing else to walk
+		json_object_put(lvl->json_refs);
+		bunarena_destroy(lvl->arena);
+		return;
 	}
 	for (u32 i = 0; i < lvl->layers->len; i++) {
 		ldtk_layer *layer_i = bunlist_get(lvl->layers, i);
 		if (!chk_flag(flags, LVL_KEEP_TILES) &&
 		    layer_i->type == LDTK_LAYER_TILES) {
 			bunlist_destroy(layer_i->content);
-		}
-		if (layer_i->tileset_path != NULL) {
-			free(layer_i->tileset_path);
-		}
-		if (layer_i->composite != NULL) {
-			free(layer_i->composite);
+			free(layer_i->cols);
 		}
 		if (layer_i->type == LDTK_LAYER_ENTITY) {
 			bunlist_destroy(layer_i->content);
 		}
+		if (layer_i->grid != NULL) {
+			free(layer_i->grid->cells);
+			free(layer_i->grid);
+		}
 	}
 	if (!chk_flag(flags, LVL_KEEP_TILES)) {
 		bunlist_destroy(lvl->layers);
@@ -257,10 +598,7 @@ void ldtk_destroy_lvl_ex(ldtk_lvl *lvl, LDTK_LVL_FLAGS flags)
 	}
 
 	if (!chk_flag(flags, LVL_KEEP_NGBR)) {
-		for (u32 i = 0; i < lvl->ngbrs->len; i++) {
-			ldtk_ngbr *ngbr = bunlist_get(lvl->ngbrs, i);
-			free(ngbr->path);
-		}
+		// free_neighbours releases each path
 		bunlist_destroy(lvl->ngbrs);
 	}
 	bunlist_destroy(lvl->walls);
@@ -269,165 +607,704 @@ void ldtk_destroy_lvl_ex(ldtk_lvl *lvl, LDTK_LVL_FLAGS flags)
 	free(lvl);
 }
 
+LDTK_CHANGE ldtk_reload_layer(ldtk_lvl *lvl, json_object *layer, u32 z)
+{
+	u32 at = 0;
+	while (at < lvl->layers->len &&
+	       ((ldtk_layer *)bunlist_get(lvl->layers, at))->z != z) {
+		at++;
+	}
+	if (at == lvl->layers->len)
+		return 0;
+	ldtk_layer *old = bunlist_get(lvl->layers, at);
+	const char *identifier = json_object_get_string(
+		json_object_object_get(layer, "__identifier"));
+	if (identifier == NULL || old->identifier == NULL ||
+	    strcmp(identifier, old->identifier) != 0)
+		return LDTK_CHANGE_RELOAD;
+
+	own_walls(lvl);
+	u32 kept = 0;
+	for (u32 i = 0; i < lvl->walls->len; i++) {
+		ldtk_wall *wall = bunlist_get(lvl->walls, i);
+		if (wall->layer != z) {
+			*(ldtk_wall *)bunlist_get(lvl->walls, kept++) = *wall;
+		}
+	}
+	bool had_walls = kept != lvl->walls->len;
+	lvl->walls->len = kept;
+
+	// the new layer is appended, then swapped into the slot of the old one
+	u32 len = lvl->layers->len;
+	get_layer(lvl, layer, z);
+	if (lvl->layers->len == len)
+		return LDTK_CHANGE_RELOAD;
+	old = bunlist_get(lvl->layers, at);
+	ldtk_layer *new = bunlist_get(lvl->layers, len);
+	ldtk_layer tmp = *old;
+	*old = *new;
+	*new = tmp;
+	free_layer_content(lvl, new);
+	bunlist_remove(lvl->layers, len);
+
+	LDTK_CHANGE what = old->type == LDTK_LAYER_ENTITY ? LDTK_CHANGE_ENTS :
+							    LDTK_CHANGE_TILES;
+	if (had_walls || old->grid != NULL) {
+		what |= LDTK_CHANGE_WALLS;
+	}
+	return what;
+}
+
+void ldtk_reload_fields(ldtk_lvl *lvl, json_object *field_instances)
+{
+	json_object_put(lvl->custom_fields);
+	lvl->custom_fields = NULL;
+	if (lvl->arena == NULL) {
+		free(lvl->fields);
+	}
+	lvl->fields = lvl_fields(lvl, field_instances);
+	if (!chk_flag(lvl->ctx->flags, LDTK_LEVEL_DROP_JSON)) {
+		lvl->custom_fields = json_object_get(field_instances);
+	}
+}
+
+void ldtk_rebuild_queries(ldtk_lvl *lvl)
+{
+	if (lvl->part != NULL) {
+		ldtk_part_destroy(lvl->part);
+		lvl->part = NULL;
+	}
+	if (lvl->bvh != NULL) {
+		ldtk_bvh_destroy(lvl->bvh);
+		lvl->bvh = NULL;
+	}
+	if (lvl->ent_index != NULL) {
+		ldtk_ent_index_destroy(lvl->ent_index);
+		lvl->ent_index = NULL;
+	}
+	// the layers under the level composite may have changed
+	if (lvl->composite != NULL) {
+		ldtk_image_destroy(lvl->composite);
+		lvl->composite = NULL;
+	}
+	build_lvl_queries(lvl->ctx, lvl);
+}
+
+/** \brief frees what a layer owns besides its identifier, which free_layers 
+ * takes care of, in arena mode it stays in the arena until the level goes */
+static void free_layer_content(ldtk_lvl *lvl, ldtk_layer *layer)
+{
+	if (layer->chunks != NULL) {
+		ldtk_chunks_destroy(layer->chunks);
+	}
+	if (layer->composite != NULL) {
+		ldtk_image_destroy(layer->composite);
+	}
+	if (lvl->arena != NULL)
+		return;
+	bunlist_destroy(layer->content);
+	free(layer->cols);
+	if (layer->grid != NULL) {
+		free(layer->grid->cells);
+		free(layer->grid);
+	}
+}
+
+/** \brief baked walls point into the blob and can't grow, copies them 
+ * into a list of the level before they are edited */
+static void own_walls(ldtk_lvl *lvl)
+{
+	if (!lvl->walls->subarr)
+		return;
+	bunlist *walls =
+		lvl_list(lvl, sizeof(ldtk_wall), lvl->walls->len + 16, NULL);
+	bunlist_extend(walls, lvl->walls);
+	lvl->walls = walls;
+}
+
+/** \brief baked cells are shared by every load of the level, copies
+ * them into the arena of the level before they are edited */
+static void own_grid(ldtk_lvl *lvl, ldtk_grid *grid)
+{
+	if (!grid->baked)
+		return;
+	usize size = sizeof(i32) * grid->w * grid->h;
+	i32 *cells = bunarena_alloc(lvl->arena, size);
+	memcpy(cells, grid->cells, size);
+	grid->cells = cells;
+	grid->baked = false;
+}
+
+bool ldtk_set_intgrid_cell(ldtk_lvl *lvl, ldtk_layer *layer, i32 cx, i32 cy,
+			   i32 value, bunlist *removed, bunlist *added)
+{
+	ldtk_rect rect = { cx, cy, 1, 1 };
+	return ldtk_set_intgrid_rect(lvl, layer, rect, value, removed, added);
+}
+
+bool ldtk_set_intgrid_rect(ldtk_lvl *lvl, ldtk_layer *layer, ldtk_rect rect,
+			   i32 value, bunlist *removed, bunlist *added)
+{
+	ldtk_grid *grid = layer->grid;
+	if (grid == NULL)
+		return false;
+	i32 x0 = rect.x > 0 ? rect.x : 0;
+	i32 y0 = rect.y > 0 ? rect.y : 0;
+	i32 x1 = rect.x + rect.w < grid->w ? rect.x + rect.w : grid->w;
+	i32 y1 = rect.y + rect.h < grid->h ? rect.y + rect.h : grid->h;
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	own_grid(lvl, grid);
+	bool changed = false;
+	for (i32 y = y0; y < y1; y++) {
+		i32 *row = &grid->cells[y * grid->w];
+		for (i32 x = x0; x < x1; x++) {
+			changed |= row[x] != value;
+			row[x] = value;
+		}
+	}
+	if (!changed)
+		return true;
+
+	// the walls crossing the area border are pulled in, which can make
+	// it cross other walls, so repeat until it settles
+	own_walls(lvl);
+	ldtk_rect area = { x0, y0, x1 - x0, y1 - y0 };
+	bunlist *near = bunlist_create(sizeof(ldtk_wall *), 16, NULL);
+	bool grown = true;
+	while (grown) {
+		grown = false;
+		near->len = 0;
+		walls_in_area(lvl, area, near);
+		for (u32 i = 0; i < near->len; i++) {
+			ldtk_wall *wall = *(ldtk_wall **)bunlist_get(near, i);
+			if (wall->layer != layer->z ||
+			    !rect_overlap(wall->bb, area))
+				continue;
+			i32 ax1 = area.x + area.w, ay1 = area.y + area.h;
+			i32 wx1 = wall->bb.x + wall->bb.w;
+			i32 wy1 = wall->bb.y + wall->bb.h;
+			if (wall->bb.x >= area.x && wall->bb.y >= area.y &&
+			    wx1 <= ax1 && wy1 <= ay1)
+				continue;
+			area.x = wall->bb.x < area.x ? wall->bb.x : area.x;
+			area.y = wall->bb.y < area.y ? wall->bb.y : area.y;
+			area.w = (wx1 > ax1 ? wx1 : ax1) - area.x;
+			area.h = (wy1 > ay1 ? wy1 : ay1) - area.y;
+			grown = true;
+		}
+	}
+
+	// the last query saw every wall of the settled area, those of the
+	// layer go, from the highest index down so the walls moved into
+	// their slots are never ones still to be taken out
+	bool full = false;
+	bunlist *dead = bunlist_create(sizeof(u32), near->len + 1, NULL);
+	for (u32 i = 0; i < near->len; i++) {
+		ldtk_wall *wall = *(ldtk_wall **)bunlist_get(near, i);
+		if (wall->layer == layer->z && rect_overlap(wall->bb, area)) {
+			u32 idx = wall - (ldtk_wall *)lvl->walls->items;
+			bunlist_append(dead, &idx);
+		}
+	}
+	bunlist_destroy(near);
+	bunlist_qsort(dead, cmp_idx_desc);
+	for (u32 i = 0; i < dead->len; i++) {
+		u32 idx = *(u32 *)bunlist_get(dead, i);
+		if (removed != NULL &&
+		    bunlist_append_n(removed, bunlist_get(lvl->walls, idx), 1) ==
+			    BARR_E_FULL) {
+			full = true;
+		}
+		remove_wall(lvl, idx);
+	}
+	bunlist_destroy(dead);
+
+	ldtk_grid sub = { .w = area.w, .h = area.h };
+	sub.cells = malloc(sizeof(i32) * area.w * area.h);
+	for (i32 y = 0; y < area.h; y++) {
+		memcpy(&sub.cells[y * area.w],
+		       &grid->cells[(area.y + y) * grid->w + area.x],
+		       sizeof(i32) * area.w);
+	}
+	u32 first = mesh_grid(lvl, &sub, layer->z, area.x, area.y);
+	free(sub.cells);
+	if (added != NULL &&
+	    bunlist_append_n(added, bunlist_get(lvl->walls, first),
+			     lvl->walls->len - first) == BARR_E_FULL) {
+		full = true;
+	}
+
+	// the entity index can stay, the walls are patched into the cells
+	// they touch and the bvh waits for its next query
+	for (u32 i = first; lvl->part != NULL && i < lvl->walls->len; i++) {
+		ldtk_part_add_wall(lvl, i);
+	}
+	if (lvl->bvh != NULL) {
+		lvl->bvh->dirty = true;
+	}
+	return !full;
+}
+
+/** \brief takes wall i out of lvl->walls by moving the last wall into
+ * its slot, the partition is updated for both */
+static void remove_wall(ldtk_lvl *lvl, u32 i)
+{
+	u32 last = lvl->walls->len - 1;
+	if (lvl->part != NULL) {
+		ldtk_part_remove_wall(lvl, i);
+		if (i != last) {
+			ldtk_part_remove_wall(lvl, last);
+		}
+	}
+	if (i != last) {
+		*(ldtk_wall *)bunlist_get(lvl->walls, i) =
+			*(ldtk_wall *)bunlist_get(lvl->walls, last);
+	}
+	lvl->walls->len = last;
+	if (lvl->part != NULL && i != last) {
+		ldtk_part_add_wall(lvl, i);
+	}
+}
+
+static i32 cmp_idx_desc(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+	return (x < y) - (x > y);
+}
+
+/** \brief appends the walls that can overlap area, in cells, to out. 
+ * the partition or bvh narrow them down, without them it's every wall. 
+ * a dirty bvh is not built again for this, the next edit would dirty it */
+static void walls_in_area(ldtk_lvl *lvl, ldtk_rect area, bunlist *out)
+{
+	ldtk_wall bb = { .bb = area };
+	ldtk_rect px = ldtk_wall_px(lvl, &bb);
+	if (lvl->part != NULL) {
+		ldtk_query_walls(lvl, px, out);
+		return;
+	}
+	if (lvl->bvh != NULL && !lvl->bvh->dirty) {
+		ldtk_bvh_query(lvl, px, out);
+		return;
+	}
+	for (u32 i = 0; i < lvl->walls->len; i++) {
+		ldtk_wall *wall = bunlist_get(lvl->walls, i);
+		bunlist_append(out, &wall);
+	}
+}
+
+static bool rect_overlap(ldtk_rect a, ldtk_rect b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+	       b.y < a.y + a.h;
+}
+
 void *ldtk_get_field(json_object *custom_fields, char *field)
 {
-	void *var = NULL;
 	u32 len = json_object_array_length(custom_fields);
 	for (u32 i = 0; i < len; i++) {
 		json_object *field_i =
 			json_object_array_get_idx(custom_fields, i);
-		char *ident = json_get_str(field_i, "__identifier");
+		const char *ident = json_object_get_string(
+			json_object_object_get(field_i, "__identifier"));
 		if (ident == NULL)
 			break;
 
-		if (strcmp(ident, field) == 0) {
-			var = json_get_ptr(field_i, "__value");
-		}
-		free(ident);
+		if (strcmp(ident, field) != 0)
+			continue;
+
+		// decoded like the level fields, so a value has the same
+		// type whether it comes from the json or from lvl->fields
+		json_object *one = json_object_new_array();
+		json_object_array_add(one, json_object_get(field_i));
+		ldtk_fields *fields = ldtk_fields_build(one, NULL);
+		json_object_put(one);
+		void *var = ldtk_field_dup(fields, field);
+		free(fields);
+		return var;
 	}
-	return var;
+	return NULL;
 }
 
 void *ldtk_get_lvl_field(ldtk_lvl *lvl, char *field)
 {
-	return ldtk_get_field(lvl->custom_fields, field);
+	return ldtk_field_dup(lvl->fields, field);
 }
 
 void *ldtk_get_ent_field(ldtk_ent *ent, char *field)
 {
-	return ldtk_get_field(ent->custom_fields, field);
+	return ldtk_field_dup(ent->fields, field);
+}
+
+/** \brief loads one layer instance into the level
+ * \returns false if the layer has no type, which ends the layer list */
+static bool get_layer(ldtk_lvl *lvl, json_object *layer, u32 z)
+{
+	char *layer_str = json_get_str(layer, "__type");
+	if (layer_str == NULL)
+		return false;
+	u64 start = stats_start(lvl->stats);
+	if (strcmp(layer_str, "AutoLayer") == 0) {
+		get_tilelayer(lvl, layer, "autoLayerTiles", z);
+		stats_end(lvl->stats, LDTK_PHASE_TILES, start);
+	} else if (strcmp(layer_str, "Tiles") == 0) {
+		get_tilelayer(lvl, layer, "gridTiles", z);
+		stats_end(lvl->stats, LDTK_PHASE_TILES, start);
+	} else if (strcmp(layer_str, "IntGrid") == 0) {
+		get_tilelayer(lvl, layer, "autoLayerTiles", z);
+		stats_end(lvl->stats, LDTK_PHASE_TILES, start);
+		get_intgrid(lvl, layer, z);
+	} else if (strcmp(layer_str, "Entities") == 0) {
+		get_ents(lvl, layer, z);
+		stats_end(lvl->stats, LDTK_PHASE_ENTS, start);
+	}
+	free(layer_str);
+	return true;
+}
+
+/** \brief loads the layers on a pool of threads, each layer goes into a
+ * copy of the level with lists (and an arena) of its own, which are then
+ * appended to the level in z order, so the result matches the serial loop */
+static void get_layers_parallel(ldtk_lvl *lvl, json_object *layers, u32 len)
+{
+	// the serial loop stops at the first layer without a type
+	u32 count = 0;
+	while (count < len &&
+	       json_object_get_string(json_object_object_get(
+		       json_object_array_get_idx(layers, count), "__type")) !=
+		       NULL) {
+		count++;
+	}
+
+	// the threads of ldtk_load_world already use the cores,
+	// each of them only gets its share for the layers
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 threads = cores > 1 ? cores : 1;
+	u32 world = __atomic_load_n(&lvl->ctx->world_threads, __ATOMIC_RELAXED);
+	if (world > 1) {
+		threads /= world;
+	}
+	if (threads > count) {
+		threads = count;
+	}
+	if (threads <= 1) {
+		for (u32 i = 0; i < count; i++) {
+			get_layer(lvl, json_object_array_get_idx(layers, i), i);
+		}
+		return;
+	}
+
+	layer_pool pool = { .tasks = malloc(sizeof(layer_task) * count),
+			    .len = count,
+			    .next = 0 };
+	for (u32 i = 0; i < count; i++) {
+		layer_task *task = &pool.tasks[i];
+		task->json = json_object_array_get_idx(layers, i);
+		task->part = *lvl;
+		ldtk_lvl *part = &task->part;
+		part->wall_size = 0;
+		// the threads time their layers apart, summed in merge_layer
+		task->stats = (ldtk_stats){ 0 };
+		part->stats = lvl->stats != NULL ? &task->stats : NULL;
+		if (lvl->arena != NULL) {
+			// arenas aren't thread safe, this one is merged afterwards
+			part->arena = bunarena_create(0);
+			part->json_refs = lvl->json_refs != NULL ?
+						  json_object_new_array() :
+						  NULL;
+		}
+		part->layers = lvl_list(part, sizeof(ldtk_layer), 1, free_layers);
+		part->walls = lvl_list(part, sizeof(ldtk_wall), 16, NULL);
+	}
+
+	// the calling thread is one of the workers
+	pthread_t *pool_threads = malloc(sizeof(pthread_t) * threads);
+	u32 started = 0;
+	for (; started < threads - 1; started++) {
+		if (pthread_create(&pool_threads[started], NULL, layer_main,
+				   &pool) != 0)
+			break;
+	}
+	layer_main(&pool);
+	for (u32 i = 0; i < started; i++) {
+		pthread_join(pool_threads[i], NULL);
+	}
+	free(pool_threads);
+
+	for (u32 i = 0; i < count; i++) {
+		merge_layer(lvl, &pool.tasks[i].part);
+	}
+	free(pool.tasks);
+}
+
+/** \brief a thread of get_layers_parallel, takes tasks until none are left */
+static void *layer_main(void *arg)
+{
+	layer_pool *pool = arg;
+	for (;;) {
+		u32 i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+		if (i >= pool->len)
+			break;
+		layer_task *task = &pool->tasks[i];
+		get_layer(&task->part, task->json, i);
+	}
+	return NULL;
+}
+
+/** \brief appends what a layer task loaded to the level and frees the task */
+static void merge_layer(ldtk_lvl *lvl, ldtk_lvl *part)
+{
+	bunlist_extend(lvl->layers, part->layers);
+	bunlist_extend(lvl->walls, part->walls);
+	if (part->wall_size != 0) {
+		lvl->wall_size = part->wall_size;
+	}
+	if (lvl->stats != NULL) {
+		ldtk_stats_add(lvl->stats, part->stats);
+	}
+
+	if (lvl->arena != NULL) {
+		usize refs = part->json_refs != NULL ?
+				     json_object_array_length(part->json_refs) :
+				     0;
+		for (usize i = 0; i < refs; i++) {
+			json_object *ref =
+				json_object_array_get_idx(part->json_refs, i);
+			json_object_array_add(lvl->json_refs, json_object_get(ref));
+		}
+		json_object_put(part->json_refs);
+		// the lists and strings of the layers live on in the level arena
+		bunarena_merge(lvl->arena, part->arena);
+		return;
+	}
+	// the layers are owned by lvl now, only the lists are freed
+	part->layers->free_fn = NULL;
+	bunlist_destroy(part->layers);
+	bunlist_destroy(part->walls);
 }
 
 /** \brief get the json object of a level with the given name */
-static json_object *get_lvl_json(char *name)
+static json_object *get_lvl_json(ldtk_ctx *ctx, char *name,
+				 ldtk_stats *stats)
 {
 	json_object *parsed_json = NULL;
 	char path_final[300] = "";
-	if (chk_flag(sys.flags, LDTK_MULTI_FILE)) {
+	if (chk_flag(ctx->flags, LDTK_MULTI_FILE)) {
 		char lvl_dir[300] = "";
-		strcat(lvl_dir, sys.prj_dir);
-		strcat(lvl_dir, sys.prj_name);
+		strcat(lvl_dir, ctx->prj_dir);
+		strcat(lvl_dir, ctx->prj_name);
 		strcat(lvl_dir, "/");
 		strcat(path_final, lvl_dir);
 		strcat(path_final, name);
 		strcat(path_final, ".ldtkl");
 
-		parsed_json = json_object_from_file(path_final);
+		// read and parse apart, so the stats can tell them apart
+		u64 start = stats_start(stats);
+		usize len = 0;
+		char *buf = read_file(path_final, &len);
+		stats_end(stats, LDTK_PHASE_IO, start);
+		if (buf == NULL)
+			return NULL;
+		start = stats_start(stats);
+		json_tokener *tok = json_tokener_new();
+		parsed_json = json_tokener_parse_ex(tok, buf, len);
+		stats_end(stats, LDTK_PHASE_PARSE, start);
+		json_tokener_free(tok);
+		free(buf);
+		if (stats != NULL) {
+			stats->bytes_read += len;
+			stats->bytes_parsed += len;
+		}
 		return parsed_json;
 
-	} else if (chk_flag(sys.flags, LDTK_SINGLE_FILE)) {
-		strcat(path_final, sys.prj_dir);
-		strcat(path_final, sys.prj_name);
-
-		if (chk_flag(sys.flags, LDTK_EXTENSION_JSON))
-			strcat(path_final, ".json");
-		else if (chk_flag(sys.flags, LDTK_EXTENSION_LDTK))
-			strcat(path_final, ".ldtk");
-		json_object *main_file = json_object_from_file(path_final);
-
-		json_object *lvls = json_object_object_get(main_file, "levels");
-		i32 len = json_object_array_length(lvls);
-		for (i32 i = 0; i < len; i++) {
-			json_object *lvl_i = json_object_array_get_idx(lvls, i);
-			u32 type = json_object_get_type(lvl_i);
-			if (type != json_type_null) {
-				char *lvl = json_get_str(lvl_i, "identifier");
-				if (strcmp(name, lvl) == 0) {
-					free(lvl);
-					json_object_get(lvl_i);
-					return lvl_i;
-				}
+	} else if (chk_flag(ctx->flags, LDTK_SINGLE_FILE)) {
+		u32 i = find_lvl(ctx, name, true);
+		if (i == 0)
+			return NULL;
+		ldtk_lvl_info *info = bunlist_get(ctx->lvls, i - 1);
+
+		// only tokenize the slice of the project text holding this level
+		u64 start = stats_start(stats);
+		if (ctx->prj_buf != NULL) {
+			json_tokener *tok = json_tokener_new();
+			parsed_json = json_tokener_parse_ex(
+				tok, &ctx->prj_buf[info->offset], info->len);
+			stats_end(stats, LDTK_PHASE_PARSE, start);
+			json_tokener_free(tok);
+			if (stats != NULL) {
+				stats->bytes_parsed += info->len;
 			}
+			return parsed_json;
 		}
+
+		// the ranges could not be found, fall back to the whole file,
+		// read and parsed in one go so it's all counted as parsing
+		json_object *main_file = json_object_from_file(info->path);
+		json_object *lvls = json_object_object_get(main_file, "levels");
+		parsed_json = json_object_get(
+			json_object_array_get_idx(lvls, i - 1));
+		stats_end(stats, LDTK_PHASE_PARSE, start);
+		json_object_put(main_file);
 	}
 	return parsed_json;
 }
 
-/** Loads the tiles of a tile layer*/
-static void get_tilelayer(ldtk_lvl *lvl, json_object *Layer, char *tilekey)
+/** \brief reads a whole file into a null terminated malloc'ed buffer
+ * \param len set to the size of the file
+ * \returns the buffer or NULL if the file could not be read */
+static char *read_file(char *path, usize *len)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size < 0) {
+		fclose(file);
+		return NULL;
+	}
+
+	char *buf = malloc(size + 1);
+	*len = fread(buf, 1, size, file);
+	buf[*len] = '\0';
+	fclose(file);
+	return buf;
+}
+
+/** Loads the tiles of a tile layer
+ * \param z index of the layer in layerInstances */
+static void get_tilelayer(ldtk_lvl *lvl, json_object *Layer, char *tilekey,
+			  u32 z)
 {
 	if (Layer != NULL) {
-		char tsfolder[300] = "assets/Tiles/";
-		char *p = json_get_str(Layer, "__tilesetRelPath");
-		char *bname = basename(p);
-		strcat(tsfolder, bname);
-		char *layer_identifier = json_get_str(Layer, "__identifier");
-		char identifier[300];
-		strcat(identifier, layer_identifier);
-		strcat(identifier, "\0");
-
-		bunlist *content = bunlist_create(sizeof(ldtk_tile), 400, NULL);
-		i32 tilesize = json_get_i32(Layer, "__gridSize");
-		ldtk_layer tl = { .type = LDTK_LAYER_TILES,
-				  .z = z,
-				  .tilesize = tilesize,
-				  .tileset_path = strdup(tsfolder),
-				  .composite = NULL,
-				  .content = content,
-				  .identifier = strdup(identifier) };
+		// the tileset comes from the registry, layers only keep its index
+		json_object *juid = json_object_object_get(Layer, "__tilesetDefUid");
+		i32 tileset = json_object_get_type(juid) == json_type_int ?
+				      find_tileset(lvl->ctx,
+						   json_object_get_int(juid)) :
+				      -1;
+		ldtk_tileset *ts = tileset >= 0 ?
+					   bunlist_get(lvl->ctx->tilesets, tileset) :
+					   NULL;
+
 		json_object *tiles = json_object_object_get(Layer, tilekey);
 		i32 len = json_object_array_length(tiles);
-		for (i32 j = 0; j < len; j++) {
+
+		ldtk_tile_cols *cols = NULL;
+		if (chk_flag(lvl->ctx->flags, LDTK_LEVEL_TILES_SOA)) {
+			cols = get_tile_cols(lvl, tiles);
+		}
+
+		// the tile count is known up front, so the list never grows
+		bunlist *content = lvl_list(lvl, sizeof(ldtk_tile),
+					    cols == NULL ? len : 0, NULL);
+		i32 tilesize = json_get_i32(Layer, "__gridSize");
+		ldtk_layer tl = {
+			.type = LDTK_LAYER_TILES,
+			.z = z,
+			.tilesize = tilesize,
+			.tileset_path = ts != NULL ? ts->path : NULL,
+			.tileset = tileset,
+			.composite = NULL,
+			.content = content,
+			.cols = cols,
+			.grid = NULL,
+			.chunks = NULL,
+			.identifier = json_lvl_str(lvl, Layer, "__identifier")
+		};
+		for (i32 j = 0; cols == NULL && j < len; j++) {
 			json_object *tiles_j;
 			tiles_j = json_object_array_get_idx(tiles, j);
 			get_tile(lvl, tl.content, tiles_j);
 		}
 
 		bunlist_append(lvl->layers, &tl);
-		free(p);
-		free(layer_identifier);
 	}
 }
 
 /** Loads The intgrids */
-static void get_intgrid(ldtk_lvl *lvl, json_object *gridLayer)
+static void get_intgrid(ldtk_lvl *lvl, json_object *gridLayer, u32 z)
 {
-	json_object *grid = NULL;
-
-	grid = json_object_object_get(gridLayer, "intGridCsv");
-
-	i32 len = json_object_array_length(grid);
-	i32 lenx = json_get_i32(gridLayer, "__cWid");
-	i32 leny = json_get_i32(gridLayer, "__cHei");
-
-	i32 csvgrid[len];
-
-	for (i32 i = 0; i < len; i++) {
-		json_object *grid_i = json_object_array_get_idx(grid, i);
-		i32 value = json_object_get_int(grid_i);
-		csvgrid[i] = value;
+	u64 start = stats_start(lvl->stats);
+	json_object *csv = json_object_object_get(gridLayer, "intGridCsv");
+
+	// the grid is kept on the layer for ldtk_set_intgrid_rect,
+	// on the heap so huge levels don't overflow small stacks
+	i32 w = json_get_i32(gridLayer, "__cWid");
+	i32 h = json_get_i32(gridLayer, "__cHei");
+	usize size = sizeof(i32) * w * h;
+	ldtk_grid *grid = lvl_alloc(lvl, sizeof(ldtk_grid));
+	grid->cells = lvl_calloc(lvl, size);
+	grid->w = w;
+	grid->h = h;
+	grid->baked = false;
+	lvl->wall_size = json_get_i32(gridLayer, "__gridSize");
+
+	arr_to_grid(csv, grid);
+	if (lvl->stats != NULL) {
+		for (i32 i = 0; i < w * h; i++) {
+			lvl->stats->solid_cells +=
+				ldtk_grid_value_accepted(lvl->ctx, grid->cells[i]);
+		}
 	}
+	stats_end(lvl->stats, LDTK_PHASE_INTGRID, start);
+	start = stats_start(lvl->stats);
+	mesh_grid(lvl, grid, z, 0, 0);
+	stats_end(lvl->stats, LDTK_PHASE_MESH, start);
+
+	// get_tilelayer just appended the layer
+	ldtk_layer *layer = bunlist_get(lvl->layers, lvl->layers->len - 1);
+	layer->grid = grid;
+}
 
-	// first we need to convert from a one line array (csvgrid) to an actual grid (intgrid)
-	i32 intgrid[lenx][leny] = {};
-	memset(intgrid, 0, sizeof(intgrid));
-
-	arr_to_grid(csvgrid, lenx, leny, intgrid);
-	if (chk_flag(sys.flags, LDTK_LEVEL_GREEDY_MESH)) {
-		grid_to_walls_greedy(lenx, leny, intgrid, lvl);
+/** \brief meshes grid with the mesher picked by the flags and appends the 
+ * walls to the level, tagged with z so they can be found again
+ * \param ox, oy cell of the level where the grid starts
+ * \return index of the first new wall */
+static u32 mesh_grid(ldtk_lvl *lvl, ldtk_grid *grid, u32 z, i32 ox, i32 oy)
+{
+	u32 first = lvl->walls->len;
+	if (chk_flag(lvl->ctx->flags, LDTK_LEVEL_GREEDY_MESH_LEGACY)) {
+		// the legacy mesher clears what it covered, keep the grid intact
+		ldtk_grid work = *grid;
+		work.cells = malloc(sizeof(i32) * grid->w * grid->h);
+		memcpy(work.cells, grid->cells, sizeof(i32) * grid->w * grid->h);
+		grid_to_walls_greedy(&work, lvl);
+		free(work.cells);
+	} else if (chk_flag(lvl->ctx->flags, LDTK_LEVEL_GREEDY_MESH)) {
+		grid_to_walls_rle(grid, lvl);
 	} else {
-		grid_to_walls(lenx, leny, intgrid, lvl);
+		grid_to_walls(grid, lvl);
 	}
+	for (u32 i = first; i < lvl->walls->len; i++) {
+		ldtk_wall *wall = bunlist_get(lvl->walls, i);
+		wall->bb.x += ox;
+		wall->bb.y += oy;
+		wall->layer = z;
+	}
+	return first;
 }
 
 // creates and appends tiles to the given tile list
 static void get_tile(ldtk_lvl *lvl, bunlist *tiles, json_object *tile_i)
 {
 	json_object *jpx = json_object_object_get(tile_i, "px");
-	json_object *jsrc = json_object_object_get(tile_i, "src");
 	json_object *jt = json_object_object_get(tile_i, "t");
 	json_object *jf = json_object_object_get(tile_i, "f");
-	i32 t, f, x, y, sx, sy;
+	i32 t, f, x, y;
 	x = lvl->rect.x +
 	    json_object_get_int(json_object_array_get_idx(jpx, 0));
 	y = lvl->rect.y +
 	    json_object_get_int(json_object_array_get_idx(jpx, 1));
-	sx = json_object_get_int(json_object_array_get_idx(jsrc, 0));
-	sy = json_object_get_int(json_object_array_get_idx(jsrc, 1));
 	t = json_object_get_int(jt);
 	f = json_object_get_int(jf);
 
-	ldtk_tile tile = { { x, y, 0, 0 }, { sx, sy, 0, 0 }, t, f };
+	// src follows from t and the tileset, see ldtk_tile_src
+	ldtk_tile tile = { { x, y, 0, 0 }, t, f };
 
 	bunlist_append(tiles, &tile);
 	json_object_object_del(tile_i, "px");
@@ -435,25 +1312,72 @@ static void get_tile(ldtk_lvl *lvl, bunlist *tiles, json_object *tile_i)
 	json_object_object_del(tile_i, "t");
 	json_object_object_del(tile_i, "f");
 }
+/** \brief decodes the tiles straight into packed columns
+ * \return the columns, or NULL if a tile does not fit in u16 */
+static ldtk_tile_cols *get_tile_cols(ldtk_lvl *lvl, json_object *tiles)
+{
+	u32 len = json_object_array_length(tiles);
+
+	// one block: the header, three u16 columns and the flip bytes
+	usize size = sizeof(ldtk_tile_cols) + len * (3 * sizeof(u16) + 1);
+	ldtk_tile_cols *cols = lvl_alloc(lvl, size);
+	cols->len = len;
+	cols->ox = lvl->rect.x;
+	cols->oy = lvl->rect.y;
+	cols->x = (u16 *)(cols + 1);
+	cols->y = cols->x + len;
+	cols->t = cols->y + len;
+	cols->f = (u8 *)(cols->t + len);
+
+	for (u32 i = 0; i < len; i++) {
+		json_object *tile_i = json_object_array_get_idx(tiles, i);
+		json_object *jpx = json_object_object_get(tile_i, "px");
+		i32 v[3] = {
+			json_object_get_int(json_object_array_get_idx(jpx, 0)),
+			json_object_get_int(json_object_array_get_idx(jpx, 1)),
+			json_get_i32(tile_i, "t")
+		};
+		for (u32 j = 0; j < 3; j++) {
+			if (v[j] < 0 || v[j] > UINT16_MAX) {
+				// the arena keeps the block until the level dies
+				if (lvl->arena == NULL)
+					free(cols);
+				return NULL;
+			}
+		}
+		cols->x[i] = v[0];
+		cols->y[i] = v[1];
+		cols->t[i] = v[2];
+		cols->f[i] = json_get_i32(tile_i, "f");
+	}
+	return cols;
+}
+
 /** \brief Creates the entity array inside the ldtk level */
-static void get_ents(ldtk_lvl *lvl, json_object *entityLayer)
+static void get_ents(ldtk_lvl *lvl, json_object *entityLayer, u32 z)
 {
 	json_object *entities;
 
-	char *layer_identifier = json_get_str(entityLayer, "__identifier");
-	char identifier[300];
-	strcat(identifier, layer_identifier);
-	// strcat(identifier, "\0");
 	entities = json_object_object_get(entityLayer, "entityInstances");
 	i32 len = json_object_array_length(entities);
 	ldtk_layer layer;
 	layer.type = LDTK_LAYER_ENTITY;
 	layer.z = z;
 	layer.tileset_path = NULL;
+	layer.tileset = -1;
 	layer.composite = NULL;
 	layer.tilesize = 0;
-	layer.identifier = strdup(layer_identifier);
-	layer.content = bunlist_create(sizeof(ldtk_ent), 10, free_ents);
+	layer.cols = NULL;
+	layer.grid = NULL;
+	layer.chunks = NULL;
+	layer.identifier = json_lvl_str(lvl, entityLayer, "__identifier");
+	layer.content = lvl_list(lvl, sizeof(ldtk_ent), len, free_ents);
+	// the fields are decoded below, only keep the json if it's wanted
+	bool keep_json = !chk_flag(lvl->ctx->flags, LDTK_LEVEL_DROP_JSON);
+	if (lvl->arena != NULL && keep_json) {
+		// one ref on the whole array instead of one per entity
+		json_object_array_add(lvl->json_refs, json_object_get(entities));
+	}
 	for (i32 i = 0; i < len; i++) {
 		json_object *ent;
 
@@ -469,80 +1393,103 @@ static void get_ents(ldtk_lvl *lvl, json_object *entityLayer)
 		rt.x = json_get_i32(ent, "__worldX");
 		rt.y = json_get_i32(ent, "__worldY");
 
-		json_object *field_instances = json_object_get(
-			json_object_object_get(ent, "fieldInstances"));
+		json_object *field_instances =
+			json_object_object_get(ent, "fieldInstances");
+		if (lvl->arena == NULL && keep_json) {
+			json_object_get(field_instances);
+		}
 
+		json_object *pivot = json_object_object_get(ent, "__pivot");
 		ldtk_ent f_ent = { .rect = rt,
 				   .r = r,
 				   .g = g,
 				   .b = b,
-				   .custom_fields = field_instances };
+				   .custom_fields = keep_json ? field_instances :
+								NULL,
+				   .fields = lvl_fields(lvl, field_instances),
+				   .iid = json_lvl_str(lvl, ent, "iid"),
+				   .def_uid = json_get_i32(ent, "defUid"),
+				   .pivot_x = json_object_get_double(
+					   json_object_array_get_idx(pivot, 0)),
+				   .pivot_y = json_object_get_double(
+					   json_object_array_get_idx(pivot, 1)) };
+		// every entity of a type points to the string of its def
+		f_ent.def = find_ent_def(lvl->ctx, f_ent.def_uid);
+		if (f_ent.def != NULL) {
+			f_ent.identifier = f_ent.def->identifier;
+			f_ent.tags = f_ent.def->tags;
+		} else {
+			f_ent.identifier =
+				json_lvl_str(lvl, ent, "__identifier");
+		}
 
 		bunlist_append(layer.content, &f_ent);
 	}
 	bunlist_append(lvl->layers, &layer);
-	free(layer_identifier);
 }
 
-/** \brief convert a single line csvgrid to a 2D intgrid*/
-static void arr_to_grid(i32 *csvgrid, i32 lenx, i32 leny,
-			i32 intgrid[lenx][leny])
+/** \brief copies the intGridCsv array straight into the row major grid,
+ * missing values are left at 0 */
+static void arr_to_grid(json_object *csv, ldtk_grid *grid)
 {
-	i32 lastx = 0;
-	for (i32 y = 0; y < leny; y++) {
-		for (i32 x = 0; x < lenx; x++) {
-			intgrid[x][y] = csvgrid[x + lastx];
-		}
-
-		lastx += lenx;
+	usize len = json_object_array_length(csv);
+	usize cells = (usize)grid->w * grid->h;
+	if (len > cells) {
+		len = cells;
+	}
+	for (usize i = 0; i < len; i++) {
+		json_object *csv_i = json_object_array_get_idx(csv, i);
+		grid->cells[i] = json_object_get_int(csv_i);
 	}
 }
 
 /** \brief Parses the intgrid end calls your custom create_wall function for every tile */
-static void grid_to_walls(i32 lenx, i32 leny, i32 intgrid[lenx][leny],
-			  ldtk_lvl *lvl)
+static void grid_to_walls(ldtk_grid *grid, ldtk_lvl *lvl)
 {
-	for (i32 y = 0; y < leny; y++) {
-		for (i32 x = 0; x < lenx; x++) {
-			i32 val = intgrid[x][y];
-			ldtk_rect rect = { x, y, 1, 1 };
-			ldtk_wall wall = { rect, val };
-			bunlist_append(lvl->walls, &wall);
+	ldtk_run *runs = malloc(sizeof(ldtk_run) * grid->w);
+	for (i32 y = 0; y < grid->h; y++) {
+		u32 runs_len = grid_row_runs(&grid->cells[y * grid->w], grid->w,
+					     runs, lvl->ctx);
+		for (u32 i = 0; i < runs_len; i++) {
+			for (i32 x = runs[i].x; x < runs[i].x + runs[i].w; x++) {
+				ldtk_rect rect = { x, y, 1, 1 };
+				ldtk_wall wall = { rect, runs[i].value, 0 };
+				bunlist_append(lvl->walls, &wall);
+			}
 		}
 	}
+	free(runs);
 }
 
 /** set's an area of the grid to an value */
-static void set_grid_area(ldtk_rect area, i32 lenx, i32 leny,
-			  i32 intgrid[lenx][leny], i32 value)
+static void set_grid_area(ldtk_rect area, ldtk_grid *grid, i32 value)
 {
-	for (i32 y = area.y; y < area.y + area.h; y++) {
-		for (i32 x = area.x; x < area.x + area.w; x++) {
-			if (x <= lenx && y <= leny) {
-				intgrid[x][y] = value;
-			}
+	for (i32 y = area.y; y < area.y + area.h && y < grid->h; y++) {
+		i32 *row = &grid->cells[y * grid->w];
+		for (i32 x = area.x; x < area.x + area.w && x < grid->w; x++) {
+			row[x] = value;
 		}
 	}
 };
 
 /** \brief returns wether it's possible to create row by expanding in the x direction
  * \param row the row we want to try to expand into 
- * \param lenx the x lenght of the grid
- * \param leny the y lenght of the gird
  * \param grid the grid
  * \returns bool wheter we can expand or not*/
-static bool expand_x(ldtk_rect row, i32 lenx, i32 leny, i32 grid[lenx][leny])
+static bool expand_x(ldtk_rect row, ldtk_grid *grid)
 {
 	bool expand = false;
 	i32 currx = 0;
 	i32 nextx = 0;
 	i32 cw = 1;
 	i32 finalx = row.x + row.w;
+	i32 lenx = grid->w;
+	i32 *cells = &grid->cells[row.y * grid->w];
 
 	for (i32 x = row.x; x < finalx; x++) {
-		currx = grid[x][row.y];
+		currx = cells[x];
 		if (x + 1 < lenx) {
-			nextx = grid[x + 1][row.y];
+			nextx = cells[x + 1];
 		}
 		if (currx == nextx && nextx != 0 && x + 1 < lenx) {
 			cw++;
@@ -556,13 +1503,11 @@ static bool expand_x(ldtk_rect row, i32 lenx, i32 leny, i32 grid[lenx][leny])
 
 /** \brief Expands the row of a grid in the y direction until it 
  * reaches a different value or the grid limits
- * \param 
- * \param lenx x lenght of the grid
- * \param leny y lenght of the grid
- * \param grid[lenx][leny] the grid
+ * \param row the row we want to expand
+ * \param grid the grid
  * \returns h the height we can expand on the y direction
  * **/
-static i32 expand_y(ldtk_rect row, i32 lenx, i32 leny, i32 grid[lenx][leny])
+static i32 expand_y(ldtk_rect row, ldtk_grid *grid)
 {
 	bool can_expand = true;
 
@@ -572,17 +1517,18 @@ static i32 expand_y(ldtk_rect row, i32 lenx, i32 leny, i32 grid[lenx][leny])
 	i32 y = row.y;
 	i32 x = row.x;
 	i32 w = row.w;
+	i32 leny = grid->h;
 	while (can_expand) {
-		curry = grid[row.x][y];
+		curry = grid->cells[y * grid->w + x];
 		if (y + 1 < leny) {
-			nexty = grid[x][y + 1];
+			nexty = grid->cells[(y + 1) * grid->w + x];
 		} else {
 			can_expand = false;
 		}
 
 		if (curry == nexty && nexty != 0 && y + 1 < leny) {
 			ldtk_rect row = { x, y + 1, w, 1 };
-			if (expand_x(row, lenx, leny, grid)) {
+			if (expand_x(row, grid)) {
 				h++;
 			} else {
 				can_expand = false;
@@ -597,31 +1543,30 @@ static i32 expand_y(ldtk_rect row, i32 lenx, i32 leny, i32 grid[lenx][leny])
 }
 
 /** parses the intgrid, but with greedy meshing */
-static void grid_to_walls_greedy(i32 lenx, i32 leny, i32 grid[lenx][leny],
-				 ldtk_lvl *lvl)
+static void grid_to_walls_greedy(ldtk_grid *grid, ldtk_lvl *lvl)
 {
 	i32 w = 1;
 	i32 currx = 0, nextx = 0;
-	for (i32 y = 0; y < leny; y++) {
+	i32 lenx = grid->w;
+	for (i32 y = 0; y < grid->h; y++) {
+		i32 *row = &grid->cells[y * grid->w];
 		for (i32 x = 0; x < lenx; x++) {
-			currx = grid[x][y];
+			currx = row[x];
 			if (x + 1 < lenx) {
-				nextx = grid[x + 1][y];
+				nextx = row[x + 1];
 			}
 			if (currx == nextx && nextx != 0 && x + 1 < lenx) {
 				w++;
 			}
 			if ((currx != nextx || x + 1 >= lenx)) {
-				if (ldtk_grid_value_accepted(currx)) {
+				if (ldtk_grid_value_accepted(lvl->ctx, currx)) {
 					ldtk_rect rect = { x + 1 - w, y, w, 1 };
 
-					rect.h = expand_y(rect, lenx, leny,
-							  grid);
+					rect.h = expand_y(rect, grid);
 
-					set_grid_area(rect, lenx, leny, grid,
-						      0);
+					set_grid_area(rect, grid, 0);
 
-					ldtk_wall wall = { rect, currx };
+					ldtk_wall wall = { rect, currx, 0 };
 					bunlist_append(lvl->walls, &wall);
 
 					w = 1;
@@ -631,36 +1576,558 @@ static void grid_to_walls_greedy(i32 lenx, i32 leny, i32 grid[lenx][leny],
 	}
 }
 
-/** \brief This function gets the neighbours of 
- * the given level room and appends it to the 
- * level neighbours list*/
-static void get_ngbrs(ldtk_lvl *lvl, json_object *parsed_json)
+/** \brief splits a grid row into runs of equal accepted values
+ * \param runs must have room for w runs
+ * \returns the number of runs written */
+static u32 grid_row_runs(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx)
 {
-	json_object *ngbr = json_object_object_get(parsed_json, "__neighbours");
-	i32 len = json_object_array_length(ngbr);
-	for (i32 i = 0; i < len; i++) {
-		json_object *ngbr_i = json_object_array_get_idx(ngbr, i);
-		char *n_id = json_get_str(ngbr_i, "levelIid");
-		char n_path[300];
-		char *n_dir = json_get_str(ngbr_i, "dir");
+	if (w <= 0)
+		return 0;
+	return row_runs(row, w, runs, ctx);
+}
+
+/** \brief writes the run [start, end) and keeps it only if its value
+ * is accepted, so the kernels don't need to branch on it
+ * \returns the number of runs kept, 0 or 1 */
+static inline u32 push_run(ldtk_run *run, i32 start, i32 end, i32 value,
+			   ldtk_ctx *ctx)
+{
+	*run = (ldtk_run){ start, end - start, value };
+	return ldtk_grid_value_accepted(ctx, value);
+}
+
+static u32 row_runs_scalar(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx)
+{
+	return row_runs_tail(row, w, 1, 0, runs, 0, ctx);
+}
+
+/** \brief finishes a row one cell at a time
+ * \param x the first cell that hasn't been compared to the one before it
+ * \param start where the current run started
+ * \param n the number of runs already in runs */
+static u32 row_runs_tail(i32 *row, i32 w, i32 x, i32 start, ldtk_run *runs,
+			 u32 n, ldtk_ctx *ctx)
+{
+	for (; x < w; x++) {
+		if (row[x] != row[x - 1]) {
+			n += push_run(&runs[n], start, x, row[start], ctx);
+			start = x;
+		}
+	}
+	n += push_run(&runs[n], start, w, row[start], ctx);
+	return n;
+}
+
+#ifdef LDTK_X86
+/** \brief compares 4 cells with their left neighbours at a time, only
+ * touching the runs where the values change */
+__attribute__((target("sse2"))) static u32
+row_runs_sse2(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx)
+{
+	u32 n = 0;
+	i32 start = 0;
+	i32 x = 1;
+	for (; x + 4 <= w; x += 4) {
+		__m128i curr = _mm_loadu_si128((__m128i *)&row[x]);
+		__m128i prev = _mm_loadu_si128((__m128i *)&row[x - 1]);
+		__m128 same = _mm_castsi128_ps(_mm_cmpeq_epi32(curr, prev));
+		u32 edges = ~_mm_movemask_ps(same) & 0xf;
+		while (edges != 0) {
+			i32 end = x + __builtin_ctz(edges);
+			n += push_run(&runs[n], start, end, row[start], ctx);
+			start = end;
+			edges &= edges - 1;
+		}
+	}
+	return row_runs_tail(row, w, x, start, runs, n, ctx);
+}
+
+/** \brief same as row_runs_sse2 but with 8 cells at a time */
+__attribute__((target("avx2"))) static u32
+row_runs_avx2(i32 *row, i32 w, ldtk_run *runs, ldtk_ctx *ctx)
+{
+	u32 n = 0;
+	i32 start = 0;
+	i32 x = 1;
+	for (; x + 8 <= w; x += 8) {
+		__m256i curr = _mm256_loadu_si256((__m256i *)&row[x]);
+		__m256i prev = _mm256_loadu_si256((__m256i *)&row[x - 1]);
+		__m256 same = _mm256_castsi256_ps(_mm256_cmpeq_epi32(curr, prev));
+		u32 edges = ~_mm256_movemask_ps(same) & 0xff;
+		while (edges != 0) {
+			i32 end = x + __builtin_ctz(edges);
+			n += push_run(&runs[n], start, end, row[start], ctx);
+			start = end;
+			edges &= edges - 1;
+		}
+	}
+	return row_runs_tail(row, w, x, start, runs, n, ctx);
+}
+#endif
+
+/** \brief picks the fastest run kernel the cpu supports */
+static void pick_row_runs(void)
+{
+#ifdef LDTK_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		row_runs = row_runs_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		row_runs = row_runs_sse2;
+	}
+#endif
+}
 
-		ldtk_get_lvl_name(n_id, n_path);
+/** \brief greedy meshing in a single pass, every row is split into runs
+ * and the rectangles still open from the row above that fit inside a run
+ * grow down by one, what's left of the run opens new ones.
+ * both lists are sorted by x, so each row is merged in linear time */
+static void grid_to_walls_rle(ldtk_grid *grid, ldtk_lvl *lvl)
+{
+	ldtk_run *runs = malloc(sizeof(ldtk_run) * grid->w);
+	ldtk_open_wall *open = malloc(sizeof(ldtk_open_wall) * grid->w);
+	ldtk_open_wall *next = malloc(sizeof(ldtk_open_wall) * grid->w);
+	u32 open_len = 0;
+
+	for (i32 y = 0; y < grid->h; y++) {
+		u32 runs_len = grid_row_runs(&grid->cells[y * grid->w], grid->w,
+					     runs, lvl->ctx);
+		u32 next_len = 0;
+		u32 i = 0;
+		for (u32 j = 0; j < runs_len; j++) {
+			ldtk_run *run = &runs[j];
+			i32 run_end = run->x + run->w;
+
+			// rectangles left of the run have nothing below them
+			while (i < open_len && open[i].bb.x < run->x) {
+				put_open_wall(lvl, &open[i++]);
+			}
 
-		ldtk_ngbr ngbr;
-		ngbr.path = malloc(sizeof(char) * 300);
-		strcpy(ngbr.path, n_path);
-		strcpy(ngbr.dir, n_dir);
+			// continuing every rectangle of the same value inside the
+			// run costs one new rectangle per gap between them. with
+			// more than one gap only the ones flush with the run edges
+			// keep growing and everything between them is one piece
+			u32 inside = i, gaps = 0;
+			i32 x = run->x;
+			for (; inside < open_len &&
+			       open[inside].bb.x + open[inside].bb.w <= run_end;
+			     inside++) {
+				if (open[inside].value != run->value)
+					continue;
+				gaps += open[inside].bb.x > x;
+				x = open[inside].bb.x + open[inside].bb.w;
+			}
+			gaps += x < run_end;
+
+			x = run->x;
+			for (; i < inside; i++) {
+				ldtk_open_wall *wall = &open[i];
+				i32 wall_end = wall->bb.x + wall->bb.w;
+				bool grow = wall->value == run->value &&
+					    (gaps <= 1 || wall->bb.x == x ||
+					     wall_end == run_end);
+				if (!grow) {
+					put_open_wall(lvl, wall);
+					continue;
+				}
+				if (wall->bb.x > x) {
+					next[next_len++] = (ldtk_open_wall){
+						{ x, y, wall->bb.x - x, 1 }, run->value
+					};
+				}
+				wall->bb.h++;
+				next[next_len++] = *wall;
+				x = wall_end;
+			}
+			if (x < run_end) {
+				next[next_len++] = (ldtk_open_wall){
+					{ x, y, run_end - x, 1 }, run->value
+				};
+			}
+		}
+		while (i < open_len) {
+			put_open_wall(lvl, &open[i++]);
+		}
 
-		bunlist_append(lvl->ngbrs, &ngbr);
-		free(n_dir);
-		free(n_id);
+		ldtk_open_wall *swap = open;
+		open = next;
+		next = swap;
+		open_len = next_len;
+	}
+	for (u32 i = 0; i < open_len; i++) {
+		put_open_wall(lvl, &open[i]);
 	}
+
+	free(runs);
+	free(open);
+	free(next);
+}
+
+static void put_open_wall(ldtk_lvl *lvl, ldtk_open_wall *open)
+{
+	ldtk_wall wall = { open->bb, open->value, 0 };
+	bunlist_append(lvl->walls, &wall);
+}
+
+/** \brief This function gets the neighbours of
+ * the given level room from the level index and
+ * appends them to the level neighbours list*/
+static void get_ngbrs(ldtk_lvl *lvl, ldtk_lvl_info *info)
+{
+	if (info == NULL)
+		return;
+
+	// copy them all at once, then give each one its own path
+	usize start = bunlist_extend(lvl->ngbrs, info->ngbrs);
+	for (usize i = start; i < lvl->ngbrs->len; i++) {
+		ldtk_ngbr *ngbr = bunlist_get(lvl->ngbrs, i);
+		ngbr->path = lvl_strdup(lvl, ngbr->path);
+	}
+}
+
+/** \brief Reads every entry of levels[] in the main project file into
+ * ldtk_sys->lvls and hashes the iids, so level lookups never
+ * have to parse the project again */
+static void build_lvl_index(ldtk_sys *ldtk_sys, json_object *json)
+{
+	json_object *lvls = json_object_object_get(json, "levels");
+	u32 len = json_object_array_length(lvls);
+
+	ldtk_sys->lvls = bunlist_create(sizeof(ldtk_lvl_info), len + 1,
+					free_lvl_info);
+	for (u32 i = 0; i < len; i++) {
+		json_object *lvl_i = json_object_array_get_idx(lvls, i);
+		if (json_object_get_type(lvl_i) == json_type_null)
+			break;
+
+		ldtk_lvl_info info;
+		info.iid = json_get_str(lvl_i, "iid");
+		info.identifier = json_get_str(lvl_i, "identifier");
+		info.rect.x = json_get_i32(lvl_i, "worldX");
+		info.rect.y = json_get_i32(lvl_i, "worldY");
+		info.rect.w = json_get_i32(lvl_i, "pxWid");
+		info.rect.h = json_get_i32(lvl_i, "pxHei");
+		info.ngbrs = bunlist_create(sizeof(ldtk_ngbr), 6, NULL);
+
+		char path[300] = "";
+		strcat(path, ldtk_sys->prj_dir);
+		strcat(path, ldtk_sys->prj_name);
+		if (chk_flag(ldtk_sys->flags, LDTK_MULTI_FILE)) {
+			strcat(path, "/");
+			strcat(path, info.identifier);
+			strcat(path, ".ldtkl");
+		} else if (chk_flag(ldtk_sys->flags, LDTK_EXTENSION_JSON)) {
+			strcat(path, ".json");
+		} else {
+			strcat(path, ".ldtk");
+		}
+		info.path = strdup(path);
+
+		bunlist_append(ldtk_sys->lvls, &info);
+	}
+
+	// power of two at least twice the level count, keeps probes short
+	u32 cap = 16;
+	while (cap < ldtk_sys->lvls->len * 2) {
+		cap *= 2;
+	}
+	ldtk_sys->map_mask = cap - 1;
+	ldtk_sys->iid_map = calloc(cap, sizeof(u32));
+	ldtk_sys->name_map = calloc(cap, sizeof(u32));
+	for (u32 i = 0; i < ldtk_sys->lvls->len; i++) {
+		ldtk_lvl_info *info = bunlist_get(ldtk_sys->lvls, i);
+		u32 slot = ldtk_hash_str(info->iid) & ldtk_sys->map_mask;
+		while (ldtk_sys->iid_map[slot] != 0) {
+			slot = (slot + 1) & ldtk_sys->map_mask;
+		}
+		ldtk_sys->iid_map[slot] = i + 1;
+
+		slot = ldtk_hash_str(info->identifier) & ldtk_sys->map_mask;
+		while (ldtk_sys->name_map[slot] != 0) {
+			slot = (slot + 1) & ldtk_sys->map_mask;
+		}
+		ldtk_sys->name_map[slot] = i + 1;
+	}
+
+	// neighbours can only be resolved once every iid is in the table
+	for (u32 i = 0; i < ldtk_sys->lvls->len; i++) {
+		ldtk_lvl_info *info = bunlist_get(ldtk_sys->lvls, i);
+		json_object *lvl_i = json_object_array_get_idx(lvls, i);
+		json_object *ngbr = json_object_object_get(lvl_i, "__neighbours");
+		u32 ngbr_len = json_object_array_length(ngbr);
+		bunlist_reserve(info->ngbrs, ngbr_len);
+		for (u32 j = 0; j < ngbr_len; j++) {
+			json_object *ngbr_j = json_object_array_get_idx(ngbr, j);
+			const char *n_id = json_object_get_string(
+				json_object_object_get(ngbr_j, "levelIid"));
+			const char *n_dir = json_object_get_string(
+				json_object_object_get(ngbr_j, "dir"));
+
+			// levels of other worlds are not in the index
+			u32 found = find_lvl(ldtk_sys, n_id, false);
+			if (found == 0 || n_dir == NULL)
+				continue;
+
+			ldtk_lvl_info *n_info =
+				bunlist_get(ldtk_sys->lvls, found - 1);
+			ldtk_ngbr ngbr_info = { .path = n_info->identifier,
+						.id = found - 1 };
+			strncpy(ngbr_info.dir, n_dir, sizeof(ngbr_info.dir) - 1);
+			ngbr_info.dir[sizeof(ngbr_info.dir) - 1] = '\0';
+			bunlist_append(info->ngbrs, &ngbr_info);
+		}
+	}
+}
+
+/** \brief looks up a level in the iid or identifier table of ldtk_sys
+ * \param key the iid, or the identifier if by_name is true
+ * \returns the index of the level in ldtk_sys->lvls plus one, or 0 if not found */
+static u32 find_lvl(ldtk_sys *ldtk_sys, const char *key, bool by_name)
+{
+	u32 *map = by_name ? ldtk_sys->name_map : ldtk_sys->iid_map;
+	if (key == NULL || map == NULL)
+		return 0;
+
+	u32 mask = ldtk_sys->map_mask;
+	for (u32 slot = ldtk_hash_str(key) & mask; map[slot] != 0;
+	     slot = (slot + 1) & mask) {
+		ldtk_lvl_info *info = bunlist_get(ldtk_sys->lvls, map[slot] - 1);
+		char *info_key = by_name ? info->identifier : info->iid;
+		if (strcmp(info_key, key) == 0)
+			return map[slot];
+	}
+	return 0;
+}
+
+/** \brief finds the byte range of every element of the top level levels[] 
+ * array without building a DOM and stores it in the matching ldtk_lvl_info
+ * \returns the number of ranges found */
+static u32 skim_lvl_ranges(char *buf, usize len, bunlist *lvls)
+{
+	i32 depth = 0;
+	u32 found = 0;
+	usize start = 0;
+	bool levels_key = false;
+	bool in_levels = false;
+
+	for (usize i = 0; i < len; i++) {
+		switch (buf[i]) {
+		case '"': {
+			usize str = i + 1;
+			for (i = str; i < len && buf[i] != '"'; i++) {
+				if (buf[i] == '\\')
+					i++;
+			}
+			// the last string before a [ at depth 1 is its key
+			if (depth == 1 && !in_levels) {
+				levels_key = (i - str == 6 &&
+					      memcmp(&buf[str], "levels", 6) == 0);
+			}
+			break;
+		}
+		case '{':
+		case '[':
+			if (in_levels && depth == 2) {
+				start = i;
+			} else if (depth == 1 && buf[i] == '[' && levels_key) {
+				in_levels = true;
+			}
+			depth++;
+			break;
+		case '}':
+		case ']':
+			depth--;
+			if (in_levels && depth == 2) {
+				if (found < lvls->len) {
+					ldtk_lvl_info *info = bunlist_get(lvls, found);
+					info->offset = start;
+					info->len = i + 1 - start;
+				}
+				found++;
+			} else if (in_levels && depth == 1) {
+				return found;
+			}
+			break;
+		}
+	}
+	return found;
+}
+
+static void free_lvl_info(usize i, void *itm)
+{
+	ldtk_lvl_info *info = itm;
+	free(info->iid);
+	free(info->identifier);
+	free(info->path);
+	bunlist_destroy(info->ngbrs);
+}
+
+/** \brief reads defs.entities, sorted by uid for find_ent_def */
+static bunlist *get_ent_defs(json_object *prj)
+{
+	json_object *defs = json_object_object_get(
+		json_object_object_get(prj, "defs"), "entities");
+	u32 len = json_object_array_length(defs);
+	bunlist *ent_defs =
+		bunlist_create(sizeof(ldtk_ent_def), len + 1, free_ent_def);
+	for (u32 i = 0; i < len; i++) {
+		json_object *def_i = json_object_array_get_idx(defs, i);
+		json_object *tags = json_object_object_get(def_i, "tags");
+		u32 tags_len = json_object_array_length(tags);
+		ldtk_ent_def def = {
+			.identifier = json_get_str(def_i, "identifier"),
+			.tags = bunlist_create(sizeof(char *), tags_len + 1,
+					       free_tag),
+			.uid = json_get_i32(def_i, "uid")
+		};
+		for (u32 j = 0; j < tags_len; j++) {
+			const char *tag = json_object_get_string(
+				json_object_array_get_idx(tags, j));
+			if (tag == NULL)
+				continue;
+			char *tag_dup = strdup(tag);
+			bunlist_append(def.tags, &tag_dup);
+		}
+		bunlist_append(ent_defs, &def);
+	}
+	bunlist_qsort(ent_defs, cmp_ent_def);
+	return ent_defs;
+}
+
+static void free_ent_def(usize i, void *itm)
+{
+	ldtk_ent_def *def = itm;
+	free(def->identifier);
+	bunlist_destroy(def->tags);
+}
+
+static void free_tag(usize i, void *itm)
+{
+	free(*(char **)itm);
+}
+
+static i32 cmp_ent_def(const void *a, const void *b)
+{
+	i32 ua = ((const ldtk_ent_def *)a)->uid;
+	i32 ub = ((const ldtk_ent_def *)b)->uid;
+	return (ua > ub) - (ua < ub);
+}
+
+/** \brief the entity def with that uid, or NULL */
+static ldtk_ent_def *find_ent_def(ldtk_ctx *ctx, i32 uid)
+{
+	if (ctx == NULL || ctx->ent_defs == NULL)
+		return NULL;
+	ldtk_ent_def key = { .uid = uid };
+	return bunlist_bsearch(ctx->ent_defs, &key, cmp_ent_def);
+}
+
+/** \brief points the entities of a baked level to the defs of ctx, 
+ * the blob only keeps their own copy of the identifier */
+static void intern_ents(ldtk_ctx *ctx, ldtk_lvl *lvl)
+{
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type != LDTK_LAYER_ENTITY)
+			continue;
+		for (u32 j = 0; j < layer->content->len; j++) {
+			ldtk_ent *ent = bunlist_get(layer->content, j);
+			ent->def = find_ent_def(ctx, ent->def_uid);
+			if (ent->def != NULL) {
+				ent->identifier = ent->def->identifier;
+				ent->tags = ent->def->tags;
+			}
+		}
+	}
+}
+
+/** \brief loads defs.tilesets once, with the uv of every tile, 
+ * so layers and tiles only have to keep an index */
+static bunlist *get_tilesets(json_object *prj)
+{
+	json_object *defs = json_object_object_get(
+		json_object_object_get(prj, "defs"), "tilesets");
+	u32 len = defs != NULL ? json_object_array_length(defs) : 0;
+	bunlist *tilesets =
+		bunlist_create(sizeof(ldtk_tileset), len + 1, free_tileset);
+	for (u32 i = 0; i < len; i++) {
+		json_object *def_i = json_object_array_get_idx(defs, i);
+		ldtk_tileset ts = {
+			.identifier = json_get_str(def_i, "identifier"),
+			.path = NULL,
+			.rel_path = json_get_str(def_i, "relPath"),
+			.image = NULL,
+			.uid = json_get_i32(def_i, "uid"),
+			.px_w = json_get_i32(def_i, "pxWid"),
+			.px_h = json_get_i32(def_i, "pxHei"),
+			.tile_size = json_get_i32(def_i, "tileGridSize"),
+			.spacing = json_get_i32(def_i, "spacing"),
+			.padding = json_get_i32(def_i, "padding"),
+		};
+		i32 step = ts.tile_size + ts.spacing;
+		if (step > 0) {
+			ts.cw = (ts.px_w - 2 * ts.padding + ts.spacing) / step;
+			ts.ch = (ts.px_h - 2 * ts.padding + ts.spacing) / step;
+		}
+		ts.cw = ts.cw > 0 ? ts.cw : 0;
+		ts.ch = ts.ch > 0 ? ts.ch : 0;
+
+		if (ts.rel_path != NULL) {
+			// basename() may use static storage, so split the path by hand
+			char *slash = strrchr(ts.rel_path, '/');
+			char *name = slash != NULL ? slash + 1 : ts.rel_path;
+			ts.path = malloc(strlen("assets/Tiles/") + strlen(name) + 1);
+			strcpy(ts.path, "assets/Tiles/");
+			strcat(ts.path, name);
+		}
+
+		u32 tiles = ts.cw * ts.ch;
+		ts.uvs = malloc(sizeof(f32) * 4 * (tiles + 1));
+		for (u32 t = 0; t < tiles; t++) {
+			ldtk_rect src = ldtk_tile_src(&ts, t);
+			ts.uvs[t * 4] = (f32)src.x / ts.px_w;
+			ts.uvs[t * 4 + 1] = (f32)src.y / ts.px_h;
+			ts.uvs[t * 4 + 2] = (f32)(src.x + src.w) / ts.px_w;
+			ts.uvs[t * 4 + 3] = (f32)(src.y + src.h) / ts.px_h;
+		}
+		bunlist_append(tilesets, &ts);
+	}
+	return tilesets;
+}
+
+static void free_tileset(usize i, void *itm)
+{
+	ldtk_tileset *ts = itm;
+	free(ts->identifier);
+	free(ts->path);
+	free(ts->rel_path);
+	free(ts->uvs);
+	if (ts->image != NULL) {
+		ldtk_image_destroy(ts->image);
+	}
+}
+
+/** \brief index of the tileset with that uid or -1, 
+ * projects have a handful of tilesets so a linear scan is enough */
+static i32 find_tileset(ldtk_ctx *ctx, i32 uid)
+{
+	for (u32 i = 0; i < ctx->tilesets->len; i++) {
+		ldtk_tileset *ts = bunlist_get(ctx->tilesets, i);
+		if (ts->uid == uid)
+			return i;
+	}
+	return -1;
 }
 
 static void free_ents(usize i, void *itm)
 {
 	ldtk_ent *ent_i = itm;
 	json_object_put(ent_i->custom_fields);
+	free(ent_i->fields);
+	free(ent_i->iid);
+	if (ent_i->def == NULL) {
+		free(ent_i->identifier);
+	}
 }
 
 static void free_layers(usize i, void *itm)
@@ -677,6 +2144,16 @@ static void free_neighbours(usize i, void *itm)
 	free(ngbr->path);
 }
 
+u32 ldtk_hash_str(const char *str)
+{
+	u32 hash = 2166136261u;
+	for (; *str != '\0'; str++) {
+		hash ^= (u8)*str;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 static bool chk_flag(i32 flag, i32 bit)
 {
 	return ((flag & bit) == bit);
@@ -699,6 +2176,65 @@ static char *json_get_str(json_object *parent, char *key)
 	return fstr;
 }
 
+/* \brief same as json_get_str, but the string is owned by the level */
+static char *json_lvl_str(ldtk_lvl *lvl, json_object *parent, char *key)
+{
+	return lvl_strdup(lvl, json_object_get_string(
+				       json_object_object_get(parent, key)));
+}
+
+/** \brief copies str into the memory of the level, its arena in arena mode */
+static char *lvl_strdup(ldtk_lvl *lvl, const char *str)
+{
+	if (str == NULL)
+		return NULL;
+	stats_alloc(lvl->stats, strlen(str) + 1);
+	if (lvl->arena != NULL)
+		return bunarena_strdup(lvl->arena, str);
+	return strdup(str);
+}
+
+/** \brief size bytes for the level, from its arena in arena mode */
+static void *lvl_alloc(ldtk_lvl *lvl, usize size)
+{
+	stats_alloc(lvl->stats, size);
+	if (lvl->arena != NULL)
+		return bunarena_alloc(lvl->arena, size);
+	return malloc(size);
+}
+
+/** \brief same as lvl_alloc, but zeroed */
+static void *lvl_calloc(ldtk_lvl *lvl, usize size)
+{
+	stats_alloc(lvl->stats, size);
+	if (lvl->arena != NULL)
+		return bunarena_calloc(lvl->arena, size);
+	return calloc(1, size);
+}
+
+/** \brief decodes the fields of the level or of one of its entities */
+static ldtk_fields *lvl_fields(ldtk_lvl *lvl, json_object *field_instances)
+{
+	ldtk_fields *fields = ldtk_fields_build(field_instances, lvl->arena);
+	if (fields != NULL) {
+		stats_alloc(lvl->stats, fields->size);
+	}
+	return fields;
+}
+
+/** \brief creates a list for the level, inside of its arena in arena mode,
+ * where free_fn is dropped since nothing in the arena is freed one by one.
+ * the stats count the header and the first cap items, not later growth */
+static bunlist *lvl_list(ldtk_lvl *lvl, usize isize, usize cap,
+			 void (*free_fn)(usize i, void *itm))
+{
+	stats_alloc(lvl->stats, sizeof(bunlist));
+	stats_alloc(lvl->stats, isize * cap);
+	if (lvl->arena != NULL)
+		return bunlist_create_arena(lvl->arena, isize, cap, NULL);
+	return bunlist_create(isize, cap, free_fn);
+}
+
 /* \brief gets the value of the requested key in the json_object and returns a pointer to it */
 static void *json_get_ptr(json_object *obj, char *key)
 {
@@ -759,15 +2295,193 @@ static void *json_get_ptr(json_object *obj, char *key)
 	return var;
 }
 
+void ldtk_set_partition_size(u32 size)
+{
+	ldtk_set_partition_size_ctx(&sys, size);
+}
+
+void ldtk_set_partition_size_ctx(ldtk_ctx *ctx, u32 size)
+{
+	ctx->part_size = size;
+}
+
+void ldtk_set_chunk_size(u32 size)
+{
+	ldtk_set_chunk_size_ctx(&sys, size);
+}
+
+void ldtk_set_chunk_size_ctx(ldtk_ctx *ctx, u32 size)
+{
+	ctx->chunk_size = size;
+}
+
+void ldtk_set_stats_cb(ldtk_stats_fn fn, void *user)
+{
+	ldtk_set_stats_cb_ctx(&sys, fn, user);
+}
+
+void ldtk_set_stats_cb_ctx(ldtk_ctx *ctx, ldtk_stats_fn fn, void *user)
+{
+	ctx->stats_fn = fn;
+	ctx->stats_user = user;
+}
+
+void ldtk_stats_add(ldtk_stats *sum, const ldtk_stats *stats)
+{
+	for (u32 i = 0; i < LDTK_PHASE_COUNT; i++) {
+		sum->ns[i] += stats->ns[i];
+	}
+	sum->total_ns += stats->total_ns;
+	sum->bytes_read += stats->bytes_read;
+	sum->bytes_parsed += stats->bytes_parsed;
+	sum->arena_allocs += stats->arena_allocs;
+	sum->arena_bytes += stats->arena_bytes;
+	sum->allocs += stats->allocs;
+	sum->alloc_bytes += stats->alloc_bytes;
+	sum->tiles += stats->tiles;
+	sum->walls += stats->walls;
+	sum->ents += stats->ents;
+	sum->solid_cells += stats->solid_cells;
+	sum->baked |= stats->baked;
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** \brief the start of a phase, without stats only the check is paid */
+static u64 stats_start(ldtk_stats *stats)
+{
+	return stats != NULL ? now_ns() : 0;
+}
+
+static void stats_end(ldtk_stats *stats, LDTK_PHASE phase, u64 start)
+{
+	if (stats != NULL) {
+		stats->ns[phase] += now_ns() - start;
+	}
+}
+
+/** \brief counts an allocation the loader makes for the level, in
+ * the arena or on the heap, without stats only the check is paid */
+static void stats_alloc(ldtk_stats *stats, usize size)
+{
+	if (stats != NULL) {
+		stats->allocs++;
+		stats->alloc_bytes += size;
+	}
+}
+
+/** \brief counts what the loaded level holds */
+static void count_lvl_stats(ldtk_lvl *lvl, ldtk_stats *stats)
+{
+	stats->walls = lvl->walls->len;
+	// baked levels have no intgrid to count, their walls cover
+	// the solid cells once so the areas add up to the same
+	if (stats->baked) {
+		for (u32 i = 0; i < lvl->walls->len; i++) {
+			ldtk_wall *wall = bunlist_get(lvl->walls, i);
+			stats->solid_cells += wall->bb.w * wall->bb.h;
+		}
+	}
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type == LDTK_LAYER_ENTITY) {
+			stats->ents += layer->content->len;
+		} else {
+			stats->tiles += ldtk_layer_tile_count(layer);
+		}
+	}
+	if (lvl->arena != NULL) {
+		stats->arena_allocs = lvl->arena->allocs;
+		stats->arena_bytes = lvl->arena->bytes;
+	}
+}
+
+ldtk_rect ldtk_wall_px(ldtk_lvl *lvl, ldtk_wall *wall)
+{
+	ldtk_rect rect = { lvl->rect.x + wall->bb.x * lvl->wall_size,
+			   lvl->rect.y + wall->bb.y * lvl->wall_size,
+			   wall->bb.w * lvl->wall_size,
+			   wall->bb.h * lvl->wall_size };
+	return rect;
+}
+
+ldtk_tileset *ldtk_get_tileset(i32 uid)
+{
+	return ldtk_get_tileset_ctx(&sys, uid);
+}
+
+ldtk_tileset *ldtk_get_tileset_ctx(ldtk_ctx *ctx, i32 uid)
+{
+	i32 i = find_tileset(ctx, uid);
+	return i >= 0 ? bunlist_get(ctx->tilesets, i) : NULL;
+}
+
+ldtk_tileset *ldtk_layer_tileset(ldtk_lvl *lvl, ldtk_layer *layer)
+{
+	if (layer->tileset < 0 || (u32)layer->tileset >= lvl->ctx->tilesets->len)
+		return NULL;
+	return bunlist_get(lvl->ctx->tilesets, layer->tileset);
+}
+
+u32 ldtk_layer_tile_count(ldtk_layer *layer)
+{
+	if (layer->cols != NULL)
+		return layer->cols->len;
+	return layer->content != NULL ? layer->content->len : 0;
+}
+
+void ldtk_layer_tile(ldtk_layer *layer, u32 i, ldtk_tile *tile)
+{
+	ldtk_tile_cols *cols = layer->cols;
+	if (cols == NULL) {
+		*tile = *(ldtk_tile *)bunlist_get(layer->content, i);
+		return;
+	}
+	tile->rect = (ldtk_rect){ cols->ox + cols->x[i], cols->oy + cols->y[i],
+				  0, 0 };
+	tile->t = cols->t[i];
+	tile->f = cols->f[i];
+}
+
+ldtk_rect ldtk_tile_src(ldtk_tileset *tileset, u32 t)
+{
+	ldtk_rect rect = { 0, 0, 0, 0 };
+	if (tileset == NULL || t >= (u32)(tileset->cw * tileset->ch))
+		return rect;
+	i32 step = tileset->tile_size + tileset->spacing;
+	rect.x = tileset->padding + (t % tileset->cw) * step;
+	rect.y = tileset->padding + (t / tileset->cw) * step;
+	rect.w = tileset->tile_size;
+	rect.h = tileset->tile_size;
+	return rect;
+}
+
 void ldtk_ignore_intgrid_value(u32 value)
 {
-	bunlist_append(sys.ignored_intgrid_values, &value);
+	ldtk_ignore_intgrid_value_ctx(&sys, value);
 }
 
-static bool ldtk_grid_value_accepted(u32 value)
+void ldtk_ignore_intgrid_value_ctx(ldtk_ctx *ctx, u32 value)
 {
-	for (u32 i = 0; i < sys.ignored_intgrid_values->len; i++) {
-		u32 *arrval = bunlist_get(sys.ignored_intgrid_values, i);
+	bunlist_append(ctx->ignored_intgrid_values, &value);
+	if (value < 64) {
+		ctx->ignored_mask |= 1ull << value;
+	}
+}
+
+static bool ldtk_grid_value_accepted(ldtk_ctx *ctx, u32 value)
+{
+	// intgrid values are small, so this is almost always a single test
+	if (value < 64) {
+		return ((ctx->ignored_mask >> value) & 1) == 0;
+	}
+	for (u32 i = 0; i < ctx->ignored_intgrid_values->len; i++) {
+		u32 *arrval = bunlist_get(ctx->ignored_intgrid_values, i);
 		if (*arrval == value) {
 			return false;
 		}
@@ -7,15 +7,29 @@
 #include <json-c/json.h>
 #include "bunlist.h"
 
-typedef enum : u16 {
+typedef enum : u32 {
 	LDTK_EXTENSION_LDTK = 0x00000100,
 	/**< Uses .ldtkl as the extension for the main ldtk file */ // DONE
 	LDTK_EXTENSION_JSON = 0x00000200,
 	/**< Uses .json as the extension for the main ldtk file */ // DONE
 	LDTK_LEVEL_GREEDY_MESH = 0x00004000,
 	/**< Enables greedy meshing on the level walls, returning rectlanges with w, and h */ // DONE
+	LDTK_LEVEL_GREEDY_MESH_LEGACY = 0x00000400,
+	/**< Greedy meshing with the old expand_x / expand_y mesher, kept around for comparison */ // DONE
 	LDTK_LEVEL_GRID_PARTITION = 0x00000800,
-	/**< Enables a grid spatial partitioning and assigns a grid cell value to each wall*/ //TBA
+	/**< Enables a grid spatial partitioning of the walls and entities, see ldtk_query_walls */ // DONE
+	LDTK_LEVEL_BVH = 0x00008000,
+	/**< Builds a bounding volume hierarchy over the level walls, see ldtk_bvh_sweep */ // DONE
+	LDTK_LEVEL_ARENA = 0x00010000,
+	/**< Allocates all the memory of a level from one arena, so destroying it is a single free */ // DONE
+	LDTK_LEVEL_TILES_SOA = 0x00020000,
+	/**< Stores the tiles of tile layers as packed columns in layer->cols, see ldtk_tile_cols */ // DONE
+	LDTK_LEVEL_PARALLEL_LAYERS = 0x00040000,
+	/**< Decodes the layers of a level on a thread each, they still end up in lvl->layers in z order. inside ldtk_load_world a level only gets its share of the cores */ // DONE
+	LDTK_LEVEL_DROP_JSON = 0x00080000,
+	/**< Keeps only the decoded fields, custom_fields is NULL and no json-c object outlives ldtk_load_lvl */ // DONE
+	LDTK_LEVEL_CHUNKS = 0x00100000,
+	/**< Builds vertex and index arrays for the tile layers, split in chunks, see ldtk_visible_chunks */ // DONE
 	LDTK_MULTI_WORLD_ENABLE = 0x00002000,
 	/**< Enables Multi World Support */ //TBA
 
@@ -30,6 +44,15 @@ typedef enum : u8 {
 		0x00000008, /**< Does not destroy the lvl->custom_fields json_object*/
 } LDTK_LVL_FLAGS;
 
+/** what ldtk_reload_layer and ldtk_watch_poll rebuilt */
+typedef enum : u8 {
+	LDTK_CHANGE_TILES = 0x01, /**< the tiles of the layer were replaced */
+	LDTK_CHANGE_WALLS = 0x02, /**< the walls of the layer were replaced, the rest of lvl->walls may have moved */
+	LDTK_CHANGE_ENTS = 0x04, /**< the entities were replaced, pointers to the old ones are invalid */
+	LDTK_CHANGE_FIELDS = 0x08, /**< lvl->fields and lvl->custom_fields were replaced */
+	LDTK_CHANGE_RELOAD = 0x10, /**< layers were added, removed or changed type, the level must be loaded again. ldtk_watch_poll reports it on every change of the file until then */
+} LDTK_CHANGE;
+
 typedef enum
 	: u8 { LDTK_LAYER_TILES,
 	       LDTK_LAYER_INTGRID,
@@ -43,64 +66,338 @@ typedef struct ldtk_rect {
 typedef struct ldtk_wall {
 	ldtk_rect bb;
 	u8 type;
+	u16 layer; // z of the intgrid layer the wall comes from
 } ldtk_wall;
 
+/** row major grid of intgrid values, cell (x, y) is cells[y * w + x] */
+typedef struct ldtk_grid {
+	i32 *cells;
+	i32 w, h;
+	bool baked; // cells point into the baked blob, shared by every load of the level. the first edit copies them into the level
+} ldtk_grid;
+
+/** a tile of a tile layer, where it comes from in the tileset 
+ * is ldtk_tile_src of the layer tileset and t */
 typedef struct ldtk_tile {
 	ldtk_rect rect;
-	ldtk_rect src;
 	u16 t; //tile num
 	u8 f; //flip: 0= not flipped, 1 = flipx, 2 = flipy 3 = flipxy
 } ldtk_tile;
 
+/** the tiles of a layer as one packed array per member, 
+ * tile i is at (ox + x[i], oy + y[i]) in world pixels. 
+ * all the columns share a single allocation */
+typedef struct ldtk_tile_cols {
+	u32 len;
+	i32 ox, oy; // world position of the level
+	u16 *x, *y; // position in the level
+	u16 *t; //tile num
+	u8 *f; //flip: 0= not flipped, 1 = flipx, 2 = flipy 3 = flipxy
+} ldtk_tile_cols;
+
+/** a corner of a tile quad, x, y in world pixels, u, v from 0 to 1 
+ * in the tileset with the flip of the tile already applied */
+typedef struct ldtk_vertex {
+	f32 x, y;
+	f32 u, v;
+} ldtk_vertex;
+
+/** an rgba8 image, row after row. the color is premultiplied by alpha, 
+ * so it's drawn with one, one minus source alpha blending */
+typedef struct ldtk_image {
+	u32 *px; // w * h pixels, red in the low byte
+	i32 w, h;
+} ldtk_image;
+
+/** a tileset of defs.tilesets, owned by the context. tile t is at 
+ * x = padding + (t % cw) * (tile_size + spacing) and 
+ * y = padding + (t / cw) * (tile_size + spacing) in the image */
+typedef struct ldtk_tileset {
+	char *identifier;
+	char *path; // assets/Tiles/ and the file name of relPath, null for embedded tilesets
+	char *rel_path; // relPath, relative to the project directory, null for embedded tilesets
+	ldtk_image *image; // set by ldtk_load_tileset_images, null otherwise
+	f32 *uvs; // u0, v0, u1, v1 from 0 to 1 of each tile, cw * ch * 4
+	i32 uid;
+	i32 px_w, px_h; // size of the image
+	i32 tile_size, spacing, padding;
+	i32 cw, ch; // number of tiles in x and y
+} ldtk_tileset;
+
+/** \brief loads the image of a tileset for ldtk_load_tileset_images
+ * \param out set px to malloc'ed rgba8 pixels with straight alpha, 
+ * the library premultiplies and frees them
+ * \return false if the image can't be loaded */
+typedef bool (*ldtk_image_loader)(ldtk_tileset *tileset, ldtk_image *out,
+				  void *user);
+
+/** a square of chunk_size * chunk_size tiles of a layer, its tiles are 
+ * index_count indices starting at first_index in ldtk_chunks.indices */
+typedef struct ldtk_chunk {
+	ldtk_rect rect; // bounding rect of its tiles in world pixels
+	u32 first_index;
+	u32 index_count; // 6 per tile, 0 if the chunk is empty
+} ldtk_chunk;
+
+/** the tiles of a layer as quads ready to upload, 4 vertices and 2 
+ * triangles per tile, in layer order within a chunk. a layer draws 
+ * from the one tileset of layer->tileset, so a visible chunk 
+ * is a single draw call */
+typedef struct ldtk_chunks {
+	ldtk_vertex *verts;
+	u32 *indices; // into verts
+	ldtk_chunk *chunks; // cw * ch, row major
+	ldtk_rect rect; // area covered by the chunks, the level rect
+	i32 chunk_px; // width and height of a chunk in pixels, chunk_size cells of the layer grid
+	i32 tile_px; // width and height of the quads, the tile size of the tileset or the layer grid without one
+	i32 cw, ch; // number of chunks in x and y
+	u32 vert_count, index_count;
+} ldtk_chunks;
+
 typedef struct ldtk_layer {
 	char *identifier; // The layer identifier
-	char *tileset_path; // null if entity layer
-	char *composite; // will be null unless you enalbe ldtk_PNG_LAYER or LDTK_PNG_BOTH
+	char *tileset_path; // path of the layer tileset, owned by the context. null if the layer has none
+	ldtk_image *composite; // the tiles drawn into one image the size of the level, see ldtk_composite_layer. null otherwise
 	bunlist *content; // change so we actually only have one type of layer
+	ldtk_tile_cols *cols; // LDTK_LEVEL_TILES_SOA: the tiles, content is left empty. null otherwise or if a tile does not fit in u16
+	ldtk_grid *grid; // intgrid layers: the values the walls were meshed from, see ldtk_set_intgrid_rect. null otherwise
+	ldtk_chunks *chunks; // LDTK_LEVEL_CHUNKS: the tiles as vertex buffers, null otherwise or for entity layers
 	LDTK_LAYER_TYPE type;
 	u32 z;
+	i32 tileset; // index into ctx->tilesets, -1 if the layer has none
 	u16 tilesize;
 
 } ldtk_layer;
 
+typedef enum : u8 {
+	LDTK_FIELD_INT, // i32
+	LDTK_FIELD_FLOAT, // f64
+	LDTK_FIELD_BOOL, // bool
+	LDTK_FIELD_STRING, // strings and multilines
+	LDTK_FIELD_COLOR, // u32, 0xRRGGBB
+	LDTK_FIELD_POINT, // ldtk_point
+	LDTK_FIELD_ENUM, // the value name, local and extern enums
+	LDTK_FIELD_FILE, // the file path
+	LDTK_FIELD_ENTITY_REF, // the iid of the entity
+	LDTK_FIELD_TILE, // ldtk_tile_ref
+	LDTK_FIELD_UNKNOWN, // types this version can't decode, they have no values
+} LDTK_FIELD_TYPE;
+
+/** a grid cell, like the values of point fields */
+typedef struct ldtk_point {
+	i32 x, y;
+} ldtk_point;
+
+/** the value of a tile field, src is the rect in the tileset */
+typedef struct ldtk_tile_ref {
+	i32 tileset_uid;
+	ldtk_rect src;
+} ldtk_tile_ref;
+
+/** one custom field, every offset is from the start of its ldtk_fields */
+typedef struct ldtk_field {
+	u32 hash; // hash of the identifier
+	u32 name; // offset of the identifier
+	u32 data; // offset of the values, strings are stored as offsets too
+	u32 len; // number of values, 0 if null, only arrays can have more than 1
+	LDTK_FIELD_TYPE type;
+	bool array;
+} ldtk_field;
+
+/** the custom fields of a level or entity, decoded at load into a single 
+ * block that holds no pointers, so it can be copied or mapped anywhere. 
+ * it's followed by ldtk_field[len], the hash table with (index + 1) 
+ * of each field or 0 if empty, and then the values */
+typedef struct ldtk_fields {
+	u32 size; // size in bytes of the whole block
+	u32 len; // number of fields
+	u32 mask; // size of the hash table - 1
+} ldtk_fields;
+
+/** an entity of defs.entities, owned by the context */
+typedef struct ldtk_entity_def {
+	char *identifier;
+	bunlist *tags; // char *
+	i32 uid;
+} ldtk_ent_def;
+
 typedef struct ldtk_entity { // add support for multiple entity layers later
 	ldtk_rect rect;
 	json_object *custom_fields;
+	ldtk_fields *fields; // custom_fields decoded, NULL if it has none, see ldtk_field_int
+	ldtk_ent_def *def; // NULL if the project has no def with def_uid
+	char *identifier; // def->identifier, so entities of one type share the pointer. owned by the level if def is NULL
+	char *iid;
+	bunlist *tags; // def->tags, NULL if def is NULL
+	i32 def_uid;
+	f32 pivot_x, pivot_y;
 	u8 r, g, b;
 } ldtk_ent;
 
+/** a run of ldtk_ent_index.ents with the same identifier */
+typedef struct ldtk_entity_type {
+	char *identifier;
+	u32 start, count;
+} ldtk_ent_type;
+
+/** every entity of a level grouped by type, see ldtk_ents_of_type */
+typedef struct ldtk_entity_index {
+	ldtk_ent **ents; // in layer order within a type
+	ldtk_ent_type *types; // in order of first appearance
+	u32 ent_count, type_count;
+} ldtk_ent_index;
+
+/** uniform grid over the walls and entities of a level, 
+ * each cell lists every object overlapping it. 
+ * everything is in world pixels, walls are scaled by lvl->wall_size */
+typedef struct ldtk_partition {
+	ldtk_rect rect; // area covered by the cells
+	i32 cell_size; // width and height of a cell in pixels
+	i32 cw, ch; // number of cells in x and y
+	u32 *wall_start; // cw * ch offsets, the walls of cell i are wall_idx[wall_start[i]] to wall_idx[wall_end[i] - 1]
+	u32 *wall_end;
+	u32 *wall_room; // end of the room of each cell, ldtk_set_intgrid_rect adds walls up to it before moving the cell to the end
+	u32 *wall_idx; // indices into lvl->walls, with holes where cells moved out after an edit
+	u32 wall_len, wall_cap; // used and allocated size of wall_idx
+	u32 *ent_start; // same as wall_start, but for ents
+	ldtk_ent **ents;
+} ldtk_part;
+
+/** node of a ldtk_bvh, count == 0 for inner nodes */
+typedef struct ldtk_bvh_node {
+	f32 min_x, min_y, max_x, max_y;
+	u32 start; // inner: index of the left child, the right one is start + 1. leaf: first item
+	u32 count; // number of items in the leaf
+} ldtk_bvh_node;
+
+/** bounding volume hierarchy over the walls of a level, 
+ * nodes are stored depth first in one array, in world pixels */
+typedef struct ldtk_bvh {
+	ldtk_bvh_node *nodes;
+	f32 *boxes; // min_x, min_y, max_x, max_y of every item, in leaf order
+	u32 *wall_idx; // index into lvl->walls of every item, in leaf order
+	u32 node_count;
+	bool dirty; // the walls changed, the next query builds it again
+} ldtk_bvh;
+
+/** result of ldtk_bvh_raycast and ldtk_bvh_sweep */
+typedef struct ldtk_hit {
+	ldtk_wall *wall;
+	f32 t; // fraction of the movement done before the hit, from 0 to 1
+	f32 nx, ny; // normal of the wall side that was hit, 0 if it started inside
+} ldtk_hit;
+
+/** the phases of a level load timed in ldtk_stats */
+typedef enum : u8 {
+	LDTK_PHASE_IO, /**< reading the level file, 0 in single file mode where ldtk_init read the project */
+	LDTK_PHASE_PARSE, /**< parsing the json of the level */
+	LDTK_PHASE_LEVEL, /**< the level itself, its fields and color, or the whole level from a baked blob */
+	LDTK_PHASE_NGBRS, /**< get_ngbrs */
+	LDTK_PHASE_TILES, /**< get_tilelayer, the tiles of tile, auto and intgrid layers */
+	LDTK_PHASE_INTGRID, /**< reading the intgrid csv into the grid */
+	LDTK_PHASE_MESH, /**< meshing the grid into walls */
+	LDTK_PHASE_ENTS, /**< get_ents */
+	LDTK_PHASE_QUERIES, /**< the entity index and what the flags enable, partition, bvh, chunks and composites */
+	LDTK_PHASE_COUNT,
+} LDTK_PHASE;
+
+/** what one level load did, see ldtk_set_stats_cb. allocs and alloc_bytes 
+ * are counted by the loader itself for that level only, so they are right 
+ * with loads running on other threads. json-c and the query structures 
+ * built after the layers (partition, bvh, chunks, composites) are not in them */
+typedef struct ldtk_stats {
+	u64 ns[LDTK_PHASE_COUNT]; // wall time of each phase. with LDTK_LEVEL_PARALLEL_LAYERS the layer phases are summed over the threads
+	u64 total_ns; // the whole load, with freeing the json which no phase counts
+	u64 bytes_read; // of the level file
+	u64 bytes_parsed; // of json text
+	u64 arena_allocs, arena_bytes; // taken from the level arena, LDTK_LEVEL_ARENA and baked levels only
+	u64 allocs, alloc_bytes; // what the loader allocated for the level, from the heap or the arena: the level, its strings, lists (first capacity), grids, tile columns and fields
+	u32 tiles, walls, ents;
+	u32 solid_cells; // intgrid cells that became walls, the wall count before meshing
+	bool baked; // the level came from ldtk_load_baked
+} ldtk_stats;
+
 typedef struct ldtk_level {
 	ldtk_rect rect;
 	json_object *custom_fields;
+	ldtk_fields *fields; // custom_fields decoded, NULL if it has none, see ldtk_field_int
 
 	char *id;
 	char *path;
-	// char *composite; 	// will be null unless you enalbe ldtk_PNG_LEVEL or LDTK_PNG_BOTH
+	ldtk_image *composite; // every layer over the background color, see ldtk_composite_lvl. null otherwise
 	char *bg_tile_path;
 
 	bunlist *walls;
 	bunlist *layers; //change so we only have one layer type
 	bunlist *ngbrs;
+	ldtk_part *part; // null unless LDTK_LEVEL_GRID_PARTITION is set
+	ldtk_bvh *bvh; // null unless LDTK_LEVEL_BVH is set
+	ldtk_ent_index *ent_index;
+	bunarena *arena; // null unless LDTK_LEVEL_ARENA is set, holds the level and everything in it
+	json_object *json_refs; // arena mode: keeps the entity json alive instead of one ref per entity
+	struct ldtk_system *ctx; // the context the level was loaded with
+	ldtk_stats *stats; // only set while the level loads with a stats callback
 
+	u16 wall_size; // size in pixels of one wall cell, the intgrid __gridSize
 	u8 r, g, b;
 
 } ldtk_lvl;
 
 typedef struct ldtk_neighbour {
 	char *path;
-	u32 id;
+	u32 id; // index of the neighbour in the level index
 	char dir[3];
 } ldtk_ngbr;
 
+/** one entry of the level index built by ldtk_init, 
+ * strings are owned by the index and valid until ldtk_free */
+typedef struct ldtk_level_info {
+	char *iid;
+	char *identifier; // the name passed to ldtk_load_lvl
+	char *path; // file where the level is stored (.ldtkl or the main file)
+	ldtk_rect rect; // world position and size in pixels
+	bunlist *ngbrs; // ldtk_ngbr, path points to the neighbour identifier
+	usize offset; // single file mode: byte range of the level in the main file
+	usize len;
+} ldtk_lvl_info;
+
+/** a blob written by ldtk_bake and mapped by ldtk_load_baked */
+typedef struct ldtk_baked ldtk_baked;
+
+/** \brief called at the end of every level load with what it did, 
+ * from the thread that loaded the level */
+typedef void (*ldtk_stats_fn)(ldtk_lvl *lvl, const ldtk_stats *stats,
+			      void *user);
+
 typedef struct ldtk_system {
 	char *prj_dir;
 	char *prj_name;
 	bunlist *ignored_intgrid_values;
+	u64 ignored_mask; // bit v is set if value v < 64 is ignored
+	bunlist *lvls; // ldtk_lvl_info of every level, in project order
+	u32 *iid_map; // open addressing table of (index + 1) into lvls, 0 is empty
+	u32 *name_map; // same as iid_map, but hashed by identifier
+	u32 map_mask;
+	char *prj_buf; // single file mode: text of the main file, NULL otherwise
+	bunlist *ent_defs; // ldtk_ent_def of defs.entities, sorted by uid
+	bunlist *tilesets; // ldtk_tileset of defs.tilesets, in project order
+	ldtk_baked *baked; // set by ldtk_load_baked, levels are loaded from it when not NULL
 
 	LDTK_FLAGS flags;
 	u32 tl_size;
+	u32 part_size; // cell size in pixels for LDTK_LEVEL_GRID_PARTITION
+	u32 chunk_size; // chunk width and height in tiles for LDTK_LEVEL_CHUNKS
+	ldtk_stats_fn stats_fn; // NULL unless set with ldtk_set_stats_cb
+	void *stats_user;
+	u32 world_threads; // threads ldtk_load_world is loading with, LDTK_LEVEL_PARALLEL_LAYERS shares the cores with them
 } ldtk_sys;
 
+/** a loaded project, every function without a ctx parameter uses the 
+ * one set up by ldtk_init. a context is only read while loading, so 
+ * loading levels from many threads at once with the same context is safe, 
+ * as long as nothing changes its settings meanwhile */
+typedef ldtk_sys ldtk_ctx;
+
 /** \brief Initilze the ldtk loading system,it will read you json 
  * briefly to check your settings, you can also enable extra functionalities 
  * \param tl_size tile size
@@ -109,34 +406,456 @@ typedef struct ldtk_system {
  * \param flags one or more ldtk_FLAGS or'ed together */
 void ldtk_init(u32 tl_size, char *prj_name, char *lvl_dir, LDTK_FLAGS flags);
 
+/** \brief same as ldtk_init, but for a context of its own, 
+ * so more than one project can be open at once
+ * \return *ldtk_ctx, free it with ldtk_free_ctx */
+ldtk_ctx *ldtk_init_ctx(u32 tl_size, char *prj_name, char *prj_dir,
+			LDTK_FLAGS flags);
+
+/** \brief the context used by ldtk_init and the functions without a ctx parameter */
+ldtk_ctx *ldtk_get_ctx(void);
+
 /** free's ldtk system */
 void ldtk_free(void);
 
+/** \brief free's a context made by ldtk_init_ctx, dropping its prefetched levels. 
+ * levels loaded with it must be destroyed first */
+void ldtk_free_ctx(ldtk_ctx *ctx);
+
 /** \brief ignore the given intgrid and do not create walls with it*/
 void ldtk_ignore_intgrid_value(u32 value);
+void ldtk_ignore_intgrid_value_ctx(ldtk_ctx *ctx, u32 value);
+
+/** \brief sets the cell size used by LDTK_LEVEL_GRID_PARTITION for levels loaded afterwards
+ * \param size width and height of a cell in pixels, defaults to 8 tiles */
+void ldtk_set_partition_size(u32 size);
+void ldtk_set_partition_size_ctx(ldtk_ctx *ctx, u32 size);
+
+/** \brief sets the chunk size used by LDTK_LEVEL_CHUNKS for levels loaded afterwards
+ * \param size width and height of a chunk in tiles, defaults to 32 */
+void ldtk_set_chunk_size(u32 size);
+void ldtk_set_chunk_size_ctx(ldtk_ctx *ctx, u32 size);
+
+/** \brief times the phases of every level load and counts what they made, 
+ * the stats are passed to fn once the level is loaded. a load without a 
+ * callback only checks for it, so leave it NULL outside of profiling 
+ * \param fn NULL disables the stats, it must be thread safe when levels 
+ * are loaded from many threads */
+void ldtk_set_stats_cb(ldtk_stats_fn fn, void *user);
+void ldtk_set_stats_cb_ctx(ldtk_ctx *ctx, ldtk_stats_fn fn, void *user);
+
+/** \brief adds the counts and times of stats to sum, to aggregate loads */
+void ldtk_stats_add(ldtk_stats *sum, const ldtk_stats *stats);
+
+/** \brief converts the wall bb from wall cells to world pixels */
+ldtk_rect ldtk_wall_px(ldtk_lvl *lvl, ldtk_wall *wall);
+
+/** \brief finds the tileset with that uid, like the tileset_uid of tile fields
+ * \return *ldtk_tileset owned by the context, or NULL */
+ldtk_tileset *ldtk_get_tileset(i32 uid);
+ldtk_tileset *ldtk_get_tileset_ctx(ldtk_ctx *ctx, i32 uid);
+
+/** \brief the tileset of a layer
+ * \return *ldtk_tileset owned by the context, or NULL if the layer has none */
+ldtk_tileset *ldtk_layer_tileset(ldtk_lvl *lvl, ldtk_layer *layer);
+
+/** \brief the number of tiles of a tile layer, in layer->cols with 
+ * LDTK_LEVEL_TILES_SOA or in layer->content otherwise */
+u32 ldtk_layer_tile_count(ldtk_layer *layer);
+
+/** \brief reads tile i of a tile layer from whichever layout it has, 
+ * the rect is in world pixels with w and h 0, like in layer->content
+ * \param i below ldtk_layer_tile_count */
+void ldtk_layer_tile(ldtk_layer *layer, u32 i, ldtk_tile *tile);
+
+/** \brief the rect of tile t in the tileset image, in pixels
+ * \return the rect, all 0 if tileset is NULL or t is not in it */
+ldtk_rect ldtk_tile_src(ldtk_tileset *tileset, u32 t);
 
 /** \brief Load level from level name
  * \param lname the name of the level to be loaded
  * \return *ldtk_lvl a pointer to the populated level struct */
 ldtk_lvl *ldtk_load_lvl(char *path);
+ldtk_lvl *ldtk_load_lvl_ctx(ldtk_ctx *ctx, char *path);
 
 /** \brief find path of level with idd
  * \param iid a String with the level
  * \param dst the string where the level name will be saved at */
 void ldtk_get_lvl_name(char *iid, char *path);
+void ldtk_get_lvl_name_ctx(ldtk_ctx *ctx, char *iid, char *path);
+
+/** \brief find the index entry of the level with iid, without touching the disk
+ * \param iid a String with the level iid
+ * \return *ldtk_lvl_info or NULL if no level has that iid */
+ldtk_lvl_info *ldtk_get_lvl_info(char *iid);
+ldtk_lvl_info *ldtk_get_lvl_info_ctx(ldtk_ctx *ctx, char *iid);
+
+/** \brief same as ldtk_get_lvl_info, but finds the level by its identifier
+ * \param name the level identifier, the same name given to ldtk_load_lvl */
+ldtk_lvl_info *ldtk_get_lvl_info_name(char *name);
+ldtk_lvl_info *ldtk_get_lvl_info_name_ctx(ldtk_ctx *ctx, char *name);
+
+/** \brief the index of every level in the project, built by ldtk_init
+ * \return bunlist of ldtk_lvl_info, owned by the ldtk system */
+bunlist *ldtk_get_lvl_index(void);
+bunlist *ldtk_get_lvl_index_ctx(ldtk_ctx *ctx);
 
 /** \brief Destroys a ldtk level structure */
 void ldtk_destroy_lvl(ldtk_lvl *lvl);
 
-/** \brief Destroys the level, but with more options*/
+/** \brief Destroys the level, but with more options, 
+ * levels loaded with LDTK_LEVEL_ARENA only honor LVL_KEEP_FIELDS */
 void ldtk_destroy_lvl_ex(ldtk_lvl *lvl, LDTK_LVL_FLAGS flags);
 
-/** \brief Returns a pointer to a malloc'ed value of the requested level custom field, you must free the pointer after using it*/
+/** \brief rebuilds layer z of a loaded level in place from its layer instance, 
+ * the old tiles, walls or entities of the layer are freed. call ldtk_rebuild_queries 
+ * once you are done reloading. ldtk_watch_poll does all of this for you
+ * \param layer the layer instance json, it is modified while decoding
+ * \return what changed, 0 if the level has no layer z */
+LDTK_CHANGE ldtk_reload_layer(ldtk_lvl *lvl, json_object *layer, u32 z);
+
+/** \brief replaces the custom fields of a loaded level with field_instances */
+void ldtk_reload_fields(ldtk_lvl *lvl, json_object *field_instances);
+
+/** \brief rebuilds the entity index and the spatial structures enabled 
+ * by the flags, after the walls or entities of a level changed */
+void ldtk_rebuild_queries(ldtk_lvl *lvl);
+
+/** \brief Returns a pointer to a malloc'ed value of the requested level custom field, you must free the pointer after using it. 
+ * the value comes from lvl->fields with or without LDTK_LEVEL_DROP_JSON, see ldtk_field_dup */
 void *ldtk_get_lvl_field(ldtk_lvl *lvl, char *field);
 
-/** \brief Returns a pointer to a malloc'ed value of the requested Entity custom field, you must free the pointer after using it*/
+/** \brief Returns a pointer to a malloc'ed value of the requested Entity custom field, you must free the pointer after using it. 
+ * the value comes from ent->fields, like ldtk_get_lvl_field */
 void *ldtk_get_ent_field(ldtk_ent *ent, char *field);
 
 /** \brief gest a malloced pointer with the contents of the desired field, 
- * please free the pointer after using it */
+ * please free the pointer after using it. the value has the type ldtk_field_dup 
+ * gives it. ldtk_field_int and the other ldtk_field getters read lvl->fields 
+ * and ent->fields without allocating */
 void *ldtk_get_field(json_object *custom_fields, char *field);
+
+/** \brief decodes the fieldInstances array of a level or entity, 
+ * ldtk_load_lvl calls this for every level and entity
+ * \param arena NULL or the arena the block is taken from
+ * \return *ldtk_fields, free it with free() if it's not from an arena, NULL if there are no fields */
+ldtk_fields *ldtk_fields_build(json_object *field_instances, bunarena *arena);
+
+/** \brief checks a block read from outside, like a baked level, 
+ * so the getters never read outside of it
+ * \param size the number of bytes available at fields */
+bool ldtk_fields_valid(const ldtk_fields *fields, usize size);
+
+/** \brief finds a field by identifier, without allocating
+ * \param fields NULL or the fields to search, all the getters take NULL
+ * \return the field or NULL if there is no field with that name */
+const ldtk_field *ldtk_field_get(const ldtk_fields *fields, const char *name);
+
+/** \brief the value of an int field, or def if it's missing, null or not an int */
+i32 ldtk_field_int(const ldtk_fields *fields, const char *name, i32 def);
+
+/** \brief the value of a float field, int fields are converted, def otherwise */
+f64 ldtk_field_float(const ldtk_fields *fields, const char *name, f64 def);
+
+/** \brief the value of a bool field, or def */
+bool ldtk_field_bool(const ldtk_fields *fields, const char *name, bool def);
+
+/** \brief the value of a color field as 0xRRGGBB, or def */
+u32 ldtk_field_color(const ldtk_fields *fields, const char *name, u32 def);
+
+/** \brief gets the value of a point field
+ * \return false if it's missing or null, pt is left untouched then */
+bool ldtk_field_point(const ldtk_fields *fields, const char *name,
+		      ldtk_point *pt);
+
+/** \brief gets the value of a tile field
+ * \return false if it's missing or null */
+bool ldtk_field_tile(const ldtk_fields *fields, const char *name,
+		     ldtk_tile_ref *tile);
+
+/** \brief the value of a string, multilines, file path, enum or entity ref field
+ * \return a string owned by the fields, NULL if it's missing or null */
+const char *ldtk_field_str(const ldtk_fields *fields, const char *name);
+
+/** \brief same as ldtk_field_str, but only for enum fields */
+const char *ldtk_field_enum(const ldtk_fields *fields, const char *name);
+
+/** \brief the values of an array field, or of a single value field as an array of 1. 
+ * items are i32, f64, bool, u32 colors, ldtk_point or ldtk_tile_ref depending on the type, 
+ * use ldtk_field_str_at for strings
+ * \param type the type the field must have
+ * \param len set to the number of values, 0 if it's missing
+ * \return the values, owned by the fields, or NULL */
+const void *ldtk_field_array(const ldtk_fields *fields, const char *name,
+			     LDTK_FIELD_TYPE type, u32 *len);
+
+/** \brief a malloc'ed copy of a field value, like ldtk_get_field returns it: 
+ * i32 for ints, f64 for floats, bool, and a string for the types that are 
+ * strings in the json (colors as #rrggbb). points, tiles and arrays return NULL
+ * \return the value, free it after using it, or NULL if it's missing or null */
+void *ldtk_field_dup(const ldtk_fields *fields, const char *name);
+
+/** \brief item i of an array of strings, file paths, enums or entity refs
+ * \return NULL if it's missing or null */
+const char *ldtk_field_str_at(const ldtk_fields *fields, const char *name,
+			      u32 i);
+
+/** \brief groups the entities of the level by identifier, ldtk_load_lvl 
+ * calls this for every level, call it again if you change the entity layers
+ * \return *ldtk_ent_index, destroy it with ldtk_ent_index_destroy */
+ldtk_ent_index *ldtk_ent_index_build(ldtk_lvl *lvl);
+
+/** \brief free's the index */
+void ldtk_ent_index_destroy(ldtk_ent_index *index);
+
+/** \brief every entity of the level with that identifier, without scanning them
+ * \param count set to the number of entities, 0 if there are none
+ * \return a slice of lvl->ent_index->ents, owned by the level, or NULL */
+ldtk_ent **ldtk_ents_of_type(ldtk_lvl *lvl, const char *identifier,
+			     u32 *count);
+
+/** \brief true if the def of the entity has that tag */
+bool ldtk_ent_has_tag(ldtk_ent *ent, const char *tag);
+
+/** \brief builds a grid partition over the walls and entities of the level, 
+ * ldtk_load_lvl calls this when LDTK_LEVEL_GRID_PARTITION is set, call it 
+ * again if you change the walls afterwards
+ * \param cell_size width and height of a cell in pixels
+ * \return *ldtk_part, destroy it with ldtk_part_destroy */
+ldtk_part *ldtk_part_build(ldtk_lvl *lvl, u32 cell_size);
+
+/** \brief free's the partition */
+void ldtk_part_destroy(ldtk_part *part);
+
+/** \brief sets the intgrid cells of the layer inside rect to value and re-meshes 
+ * only around them: the walls of the layer overlapping rect are taken out, 
+ * growing the area until no wall crosses its border, and the area is meshed 
+ * again. walls outside of it are left alone. the walls around the edit are found 
+ * with the partition or bvh when the level has one. only the partition cells 
+ * the area touches are updated, the bvh is marked dirty and built again by the 
+ * next bvh query, so many edits in a row cost one build. 
+ * the walls taken out are replaced by the last walls of lvl->walls and the new 
+ * ones are appended, so after an edit that changed a cell every ldtk_wall 
+ * pointer into lvl->walls is invalid, the list can move when it grows. a wall 
+ * keeps its index unless it was taken out or was one of the last walls
+ * \param layer a layer of lvl with a grid
+ * \param rect the cells to set, in cells of the layer, clipped to the grid
+ * \param removed NULL or a bunlist of ldtk_wall, the walls taken out are appended
+ * \param added NULL or a bunlist of ldtk_wall, the new walls are appended
+ * \return false if the layer has no grid or rect is outside of it, or if removed 
+ * or added couldn't grow to hold the walls. the edit is made either way then */
+bool ldtk_set_intgrid_rect(ldtk_lvl *lvl, ldtk_layer *layer, ldtk_rect rect,
+			   i32 value, bunlist *removed, bunlist *added);
+
+/** \brief ldtk_set_intgrid_rect for one cell */
+bool ldtk_set_intgrid_cell(ldtk_lvl *lvl, ldtk_layer *layer, i32 cx, i32 cy,
+			   i32 value, bunlist *removed, bunlist *added);
+
+/** \brief finds every wall overlapping area, each wall is reported once
+ * \param area the area in world pixels
+ * \param out a bunlist of ldtk_wall*, the walls found are appended to it
+ * \return the number of walls found, 0 if the level has no partition */
+u32 ldtk_query_walls(ldtk_lvl *lvl, ldtk_rect area, bunlist *out);
+
+/** \brief same as ldtk_query_walls, but for entities
+ * \param out a bunlist of ldtk_ent* */
+u32 ldtk_query_ents(ldtk_lvl *lvl, ldtk_rect area, bunlist *out);
+
+/** \brief finds every wall containing the point x, y in world pixels */
+u32 ldtk_query_walls_pt(ldtk_lvl *lvl, i32 x, i32 y, bunlist *out);
+
+/** \brief finds every entity containing the point x, y in world pixels */
+u32 ldtk_query_ents_pt(ldtk_lvl *lvl, i32 x, i32 y, bunlist *out);
+
+/** \brief builds a bvh over the walls of the level with a binned SAH, 
+ * ldtk_load_lvl calls this when LDTK_LEVEL_BVH is set
+ * \return *ldtk_bvh, destroy it with ldtk_bvh_destroy */
+ldtk_bvh *ldtk_bvh_build(ldtk_lvl *lvl);
+
+/** \brief free's the bvh */
+void ldtk_bvh_destroy(ldtk_bvh *bvh);
+
+/** \brief finds every wall overlapping area using the bvh. 
+ * like ldtk_bvh_raycast and ldtk_bvh_sweep, it first builds the bvh again 
+ * if ldtk_set_intgrid_rect changed the walls since the last query
+ * \param area the area in world pixels
+ * \param out a bunlist of ldtk_wall*, the walls found are appended to it
+ * \return the number of walls found, 0 if the level has no bvh */
+u32 ldtk_bvh_query(ldtk_lvl *lvl, ldtk_rect area, bunlist *out);
+
+/** \brief casts the segment from (x, y) to (x + dx, y + dy) against the walls
+ * \param hit filled with the closest wall hit
+ * \return true if a wall was hit */
+bool ldtk_bvh_raycast(ldtk_lvl *lvl, f32 x, f32 y, f32 dx, f32 dy,
+		      ldtk_hit *hit);
+
+/** \brief moves box by dx, dy and finds the first wall it runs into, 
+ * walls the box is only touching do not stop it from sliding along them
+ * \param box the box in world pixels
+ * \param hit filled with the first wall hit, box can move by t * dx, t * dy
+ * \return true if a wall was hit */
+bool ldtk_bvh_sweep(ldtk_lvl *lvl, ldtk_rect box, f32 dx, f32 dy,
+		    ldtk_hit *hit);
+
+/** \brief builds the vertex and index arrays of a tile layer, ldtk_load_lvl 
+ * calls this for every tile layer when LDTK_LEVEL_CHUNKS is set
+ * \param chunk_size width and height of a chunk in tiles
+ * \return *ldtk_chunks, destroy it with ldtk_chunks_destroy */
+ldtk_chunks *ldtk_chunks_build(ldtk_lvl *lvl, ldtk_layer *layer,
+			       u32 chunk_size);
+
+/** \brief free's the chunks */
+void ldtk_chunks_destroy(ldtk_chunks *chunks);
+
+/** \brief finds the chunks of the layer with tiles inside view
+ * \param view the area in world pixels
+ * \param out a bunlist of ldtk_chunk*, the chunks found are appended to it
+ * \return the number of chunks found, 0 if the layer has no chunks */
+u32 ldtk_visible_chunks(ldtk_layer *layer, ldtk_rect view, bunlist *out);
+
+/** \brief loads the image of every tileset of the context with loader, 
+ * composites are drawn from them. call it once after ldtk_init and 
+ * before loading levels, from then on the levels of a project that 
+ * exports images per layer or per level get their composites at load
+ * \return the number of tilesets whose image could not be loaded */
+u32 ldtk_load_tileset_images(ldtk_image_loader loader, void *user);
+u32 ldtk_load_tileset_images_ctx(ldtk_ctx *ctx, ldtk_image_loader loader,
+				 void *user);
+
+/** \brief draws the tiles of a tile layer with their flips into 
+ * layer->composite, an image the size of the level, replacing the old one. 
+ * tiles of tilesets without an image are skipped
+ * \return layer->composite, NULL for entity layers */
+ldtk_image *ldtk_composite_layer(ldtk_lvl *lvl, ldtk_layer *layer);
+
+/** \brief draws every tile layer of the level, bottom one first, over the 
+ * background color into lvl->composite, replacing the old one. 
+ * layers with a composite are blended as a whole
+ * \return lvl->composite */
+ldtk_image *ldtk_composite_lvl(ldtk_lvl *lvl);
+
+/** \brief free's the image */
+void ldtk_image_destroy(ldtk_image *image);
+
+/** \brief writes the image to path as an uncompressed png
+ * \return true if it worked */
+bool ldtk_write_png(ldtk_image *image, const char *path);
+
+/** \brief loads every level of the index and writes its composites to dir, 
+ * as <level>.png and <level>__<layer>.png. what gets written follows the 
+ * image export mode of the project, the level composite if it has none
+ * \param dir the directory, with the trailing /
+ * \return true if every png was written */
+bool ldtk_bake_composites(char *dir);
+bool ldtk_bake_composites_ctx(ldtk_ctx *ctx, char *dir);
+
+/** \brief loads every level of the index with the current flags and writes them,
+ * already meshed, to a binary blob at path, see ldtk_load_baked
+ * \return true if it worked */
+bool ldtk_bake(char *path);
+bool ldtk_bake_ctx(ldtk_ctx *ctx, char *path);
+
+/** \brief maps a blob written by ldtk_bake, ldtk_load_lvl then loads levels 
+ * from it without parsing, their big arrays point straight into the map. 
+ * call it after ldtk_init with the same project, and destroy every level 
+ * loaded from it before ldtk_free
+ * \return false if the blob can't be read, is from another version or project */
+bool ldtk_load_baked(char *path);
+bool ldtk_load_baked_ctx(ldtk_ctx *ctx, char *path);
+
+/** \brief maps and checks a blob, ldtk_load_baked is usually what you want 
+ * \return *ldtk_baked or NULL */
+ldtk_baked *ldtk_baked_open(char *path);
+ldtk_baked *ldtk_baked_open_ctx(ldtk_ctx *ctx, char *path);
+
+/** \brief unmaps the blob */
+void ldtk_baked_close(ldtk_baked *baked);
+
+/** \brief loads the level at index i of the level index from the blob, 
+ * the level is allocated from an arena, like with LDTK_LEVEL_ARENA */
+ldtk_lvl *ldtk_baked_lvl(ldtk_baked *baked, u32 i);
+
+/** \brief queues the level to be loaded by the background loader, 
+ * the loader thread is started on first use. does nothing if the level is already queued. 
+ * ldtk_load_lvl is safe to call while it runs, but settings like ldtk_ignore_intgrid_value must not change 
+ * \param name the level identifier, like in ldtk_load_lvl 
+ * \return false if the loader thread couldn't be started, ldtk_get_lvl then loads it on the calling thread */
+bool ldtk_prefetch_lvl(char *name);
+bool ldtk_prefetch_lvl_ctx(ldtk_ctx *ctx, char *name);
+
+/** \brief queues every neighbour of lvl, call it after entering a level 
+ * so the next one is decoded by the time the player crosses a border, 
+ * they are loaded with the context lvl was loaded with */
+void ldtk_prefetch_ngbrs(ldtk_lvl *lvl);
+
+/** \brief gets a prefetched level without blocking 
+ * \return the level, now owned by the caller, or NULL if it's not loaded yet or was never queued */
+ldtk_lvl *ldtk_try_get_lvl(char *name);
+ldtk_lvl *ldtk_try_get_lvl_ctx(ldtk_ctx *ctx, char *name);
+
+/** \brief gets a level, waiting for it if it's being prefetched 
+ * and loading it on the calling thread if it was not queued or not started */
+ldtk_lvl *ldtk_get_lvl(char *name);
+ldtk_lvl *ldtk_get_lvl_ctx(ldtk_ctx *ctx, char *name);
+
+/** \brief drops every level queued with the context and destroys the ones 
+ * nobody claimed, waits for the level being loaded if it's one of them */
+void ldtk_prefetch_clear(void);
+void ldtk_prefetch_clear_ctx(ldtk_ctx *ctx);
+
+/** \brief stops the loader thread, destroying the levels nobody claimed with any context. 
+ * call it at shutdown, a later prefetch starts the thread again */
+void ldtk_prefetch_stop(void);
+
+/** \brief stops the loader thread if no context has levels queued or waiting to be claimed, 
+ * ldtk_free and ldtk_free_ctx call it after dropping their own */
+void ldtk_prefetch_stop_idle(void);
+
+/** \brief loads every level of the project, spreading them over a pool of threads 
+ * \param threads how many threads to load with, counting the calling one, 0 for one per core 
+ * \return bunlist of ldtk_lvl* in project order, a level that failed to load is NULL. 
+ * bunlist_destroy destroys the levels with it */
+bunlist *ldtk_load_world(u32 threads);
+bunlist *ldtk_load_world_ctx(ldtk_ctx *ctx, u32 threads);
+
+/** one thing ldtk_watch_poll rebuilt */
+typedef struct ldtk_change {
+	ldtk_lvl *lvl; // NULL if the project itself must be loaded again
+	ldtk_layer *layer; // the rebuilt layer, NULL for LDTK_CHANGE_FIELDS and LDTK_CHANGE_RELOAD
+	u32 z;
+	LDTK_CHANGE what;
+} ldtk_change;
+
+/** watches the files of a project for hot reloading, see ldtk_watch_start */
+typedef struct ldtk_watch ldtk_watch;
+
+/** \brief starts watching the files of the project with inotify, 
+ * nothing is reloaded until you call ldtk_watch_poll. linux only. 
+ * the main file is watched too, a change to the definitions or the level list 
+ * is reported as LDTK_CHANGE_RELOAD with a NULL lvl: init the project again
+ * \return *ldtk_watch, stop it with ldtk_watch_stop, or NULL if inotify is not 
+ * available or the main file can't be parsed */
+ldtk_watch *ldtk_watch_start(ldtk_ctx *ctx);
+
+/** \brief keeps a loaded level up to date with its file, 
+ * the hash of each layer is taken now and compared on every change
+ * \return false if the level is not in the project or its file can't be read */
+bool ldtk_watch_add(ldtk_watch *watch, ldtk_lvl *lvl);
+
+/** \brief stops updating the level, do it before destroying a watched level */
+void ldtk_watch_remove(ldtk_watch *watch, ldtk_lvl *lvl);
+
+/** \brief reloads the layers and fields that changed in the watched levels, 
+ * in place, from the thread that uses the levels. never blocks. 
+ * each changed file is parsed once, whatever the number of levels in it
+ * \param on_change NULL or called once for each change, after the level is consistent again
+ * \return the number of changes */
+u32 ldtk_watch_poll(ldtk_watch *watch,
+		    void (*on_change)(ldtk_change *change, void *user),
+		    void *user);
+
+/** \brief the inotify descriptor, it becomes readable when a file changed, for poll() or select() */
+i32 ldtk_watch_fd(ldtk_watch *watch);
+
+/** \brief stops watching, the levels are left as they are */
+void ldtk_watch_stop(ldtk_watch *watch);
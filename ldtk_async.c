@@ -0,0 +1,375 @@
+/** ldtk_async.c - background level loader,
+* a worker thread decodes queued levels so
+* room transitions don't stall on parsing, 
+* and whole worlds are loaded by a pool of threads */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ldtk.h"
+
+typedef enum : u8 {
+	JOB_QUEUED,
+	JOB_LOADING,
+	JOB_DONE,
+} JOB_STATE;
+
+typedef struct async_job {
+	ldtk_ctx *ctx;
+	char *name;
+	ldtk_lvl *lvl; // set once the job is done, NULL if loading failed
+	JOB_STATE state;
+} async_job;
+
+typedef struct async_loader {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake; // signaled when a job is queued or on stop
+	pthread_cond_t done; // broadcast when a job finishes
+	bunlist *jobs; // async_job, in the order they were queued
+	bool running;
+	bool stop; // set until the stopped thread is joined, nothing can start it meanwhile
+} async_loader;
+
+/** state shared by the threads of ldtk_load_world */
+typedef struct world_loader {
+	ldtk_ctx *ctx;
+	bunlist *index; // ldtk_lvl_info of the levels to load
+	ldtk_lvl **lvls; // lvls[i] is the level of index entry i
+	u32 next; // next index entry nobody took yet, taken with an atomic add
+} world_loader;
+
+static void *loader_main(void *arg);
+static bool loader_start(void);
+static void loader_stop(void);
+static i64 find_job(ldtk_ctx *ctx, char *name);
+static i64 find_state(ldtk_ctx *ctx, JOB_STATE state);
+static void free_job(usize i, void *itm);
+static void *world_main(void *arg);
+static void free_world_lvl(usize i, void *itm);
+
+static async_loader loader = { .lock = PTHREAD_MUTEX_INITIALIZER,
+			       .wake = PTHREAD_COND_INITIALIZER,
+			       .done = PTHREAD_COND_INITIALIZER };
+
+bool ldtk_prefetch_lvl(char *name)
+{
+	return ldtk_prefetch_lvl_ctx(ldtk_get_ctx(), name);
+}
+
+bool ldtk_prefetch_lvl_ctx(ldtk_ctx *ctx, char *name)
+{
+	pthread_mutex_lock(&loader.lock);
+	if (!loader_start()) {
+		pthread_mutex_unlock(&loader.lock);
+		return false;
+	}
+	if (find_job(ctx, name) < 0) {
+		async_job job = { .ctx = ctx,
+				  .name = strdup(name),
+				  .lvl = NULL,
+				  .state = JOB_QUEUED };
+		bunlist_append(loader.jobs, &job);
+		pthread_cond_signal(&loader.wake);
+	}
+	pthread_mutex_unlock(&loader.lock);
+	return true;
+}
+
+void ldtk_prefetch_ngbrs(ldtk_lvl *lvl)
+{
+	for (u32 i = 0; i < lvl->ngbrs->len; i++) {
+		ldtk_ngbr *ngbr = bunlist_get(lvl->ngbrs, i);
+		ldtk_prefetch_lvl_ctx(lvl->ctx, ngbr->path);
+	}
+}
+
+ldtk_lvl *ldtk_try_get_lvl(char *name)
+{
+	return ldtk_try_get_lvl_ctx(ldtk_get_ctx(), name);
+}
+
+ldtk_lvl *ldtk_try_get_lvl_ctx(ldtk_ctx *ctx, char *name)
+{
+	ldtk_lvl *lvl = NULL;
+	pthread_mutex_lock(&loader.lock);
+	i64 i = find_job(ctx, name);
+	if (i >= 0) {
+		async_job *job = bunlist_get(loader.jobs, i);
+		if (job->state == JOB_DONE) {
+			lvl = job->lvl;
+			job->lvl = NULL;
+			bunlist_remove(loader.jobs, i);
+		}
+	}
+	pthread_mutex_unlock(&loader.lock);
+	return lvl;
+}
+
+ldtk_lvl *ldtk_get_lvl(char *name)
+{
+	return ldtk_get_lvl_ctx(ldtk_get_ctx(), name);
+}
+
+ldtk_lvl *ldtk_get_lvl_ctx(ldtk_ctx *ctx, char *name)
+{
+	pthread_mutex_lock(&loader.lock);
+	i64 i = find_job(ctx, name);
+	if (i < 0) {
+		pthread_mutex_unlock(&loader.lock);
+		return ldtk_load_lvl_ctx(ctx, name);
+	}
+
+	// not started yet, loading it here beats waiting behind the queue
+	async_job *job = bunlist_get(loader.jobs, i);
+	if (job->state == JOB_QUEUED) {
+		bunlist_remove(loader.jobs, i);
+		pthread_mutex_unlock(&loader.lock);
+		return ldtk_load_lvl_ctx(ctx, name);
+	}
+
+	// the job index can move while we sleep, so look it up every time
+	while (job->state != JOB_DONE) {
+		pthread_cond_wait(&loader.done, &loader.lock);
+		i = find_job(ctx, name);
+		if (i < 0) {
+			// another thread claimed it first
+			pthread_mutex_unlock(&loader.lock);
+			return ldtk_load_lvl_ctx(ctx, name);
+		}
+		job = bunlist_get(loader.jobs, i);
+	}
+	ldtk_lvl *lvl = job->lvl;
+	job->lvl = NULL;
+	bunlist_remove(loader.jobs, i);
+	pthread_mutex_unlock(&loader.lock);
+	return lvl;
+}
+
+void ldtk_prefetch_clear(void)
+{
+	ldtk_prefetch_clear_ctx(ldtk_get_ctx());
+}
+
+void ldtk_prefetch_clear_ctx(ldtk_ctx *ctx)
+{
+	pthread_mutex_lock(&loader.lock);
+	if (loader.jobs == NULL) {
+		pthread_mutex_unlock(&loader.lock);
+		return;
+	}
+	// drop what hasn't started first, so the worker picks nothing new
+	for (i64 i = (i64)loader.jobs->len - 1; i >= 0; i--) {
+		async_job *job = bunlist_get(loader.jobs, i);
+		if (job->ctx == ctx && job->state == JOB_QUEUED)
+			bunlist_remove(loader.jobs, i);
+	}
+	// a level being loaded can't be interrupted, wait for it
+	while (find_state(ctx, JOB_LOADING) >= 0) {
+		pthread_cond_wait(&loader.done, &loader.lock);
+	}
+	// removing runs free_job, which destroys the unclaimed levels,
+	// unless ldtk_prefetch_stop already did while we waited
+	for (i64 i = loader.jobs != NULL ? (i64)loader.jobs->len - 1 : -1;
+	     i >= 0; i--) {
+		async_job *job = bunlist_get(loader.jobs, i);
+		if (job->ctx == ctx)
+			bunlist_remove(loader.jobs, i);
+	}
+	pthread_mutex_unlock(&loader.lock);
+}
+
+void ldtk_prefetch_stop(void)
+{
+	pthread_mutex_lock(&loader.lock);
+	if (!loader.running || loader.stop) {
+		pthread_mutex_unlock(&loader.lock);
+		return;
+	}
+	loader_stop();
+}
+
+void ldtk_prefetch_stop_idle(void)
+{
+	pthread_mutex_lock(&loader.lock);
+	if (!loader.running || loader.stop || loader.jobs->len > 0) {
+		pthread_mutex_unlock(&loader.lock);
+		return;
+	}
+	loader_stop();
+}
+
+bunlist *ldtk_load_world(u32 threads)
+{
+	return ldtk_load_world_ctx(ldtk_get_ctx(), threads);
+}
+
+bunlist *ldtk_load_world_ctx(ldtk_ctx *ctx, u32 threads)
+{
+	bunlist *index = ldtk_get_lvl_index_ctx(ctx);
+	if (index == NULL)
+		return NULL;
+	if (threads == 0) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cores > 0 ? cores : 1;
+	}
+	if (threads > index->len) {
+		threads = index->len > 0 ? index->len : 1;
+	}
+
+	world_loader world = { .ctx = ctx,
+			       .index = index,
+			       .lvls = calloc(index->len + 1, sizeof(ldtk_lvl *)),
+			       .next = 0 };
+
+	// the calling thread is one of the workers, the count is added
+	// before any of them starts a level so their layer threads see it
+	__atomic_add_fetch(&ctx->world_threads, threads, __ATOMIC_RELAXED);
+	pthread_t *pool = malloc(sizeof(pthread_t) * threads);
+	u32 started = 0;
+	for (; started < threads - 1; started++) {
+		if (pthread_create(&pool[started], NULL, world_main, &world) != 0)
+			break;
+	}
+	world_main(&world);
+	for (u32 i = 0; i < started; i++) {
+		pthread_join(pool[i], NULL);
+	}
+	free(pool);
+	__atomic_sub_fetch(&ctx->world_threads, threads, __ATOMIC_RELAXED);
+
+	bunlist *lvls = bunlist_create(sizeof(ldtk_lvl *), index->len,
+				       free_world_lvl);
+	bunlist_append_n(lvls, world.lvls, index->len);
+	free(world.lvls);
+	return lvls;
+}
+
+/** \brief a thread of ldtk_load_world, takes the next level nobody
+ * took until there are none left, so slow levels don't hold the rest back */
+static void *world_main(void *arg)
+{
+	world_loader *world = arg;
+	for (;;) {
+		u32 i = __atomic_fetch_add(&world->next, 1, __ATOMIC_RELAXED);
+		if (i >= world->index->len)
+			break;
+		ldtk_lvl_info *info = bunlist_get(world->index, i);
+		world->lvls[i] = ldtk_load_lvl_ctx(world->ctx, info->identifier);
+	}
+	return NULL;
+}
+
+/** \brief destroys a level of a world list, levels that failed are NULL */
+static void free_world_lvl(usize i, void *itm)
+{
+	ldtk_lvl **lvl = itm;
+	if (*lvl != NULL) {
+		ldtk_destroy_lvl(*lvl);
+	}
+}
+
+/** \brief the worker, loads queued levels one at a time, oldest first */
+static void *loader_main(void *arg)
+{
+	pthread_mutex_lock(&loader.lock);
+	while (!loader.stop) {
+		i64 i = find_state(NULL, JOB_QUEUED);
+		if (i < 0) {
+			pthread_cond_wait(&loader.wake, &loader.lock);
+			continue;
+		}
+		async_job *job = bunlist_get(loader.jobs, i);
+
+		// the job can move in the list while unlocked, keep a copy of the name
+		job->state = JOB_LOADING;
+		ldtk_ctx *ctx = job->ctx;
+		char *name = strdup(job->name);
+		pthread_mutex_unlock(&loader.lock);
+
+		ldtk_lvl *lvl = ldtk_load_lvl_ctx(ctx, name);
+
+		pthread_mutex_lock(&loader.lock);
+		job = bunlist_get(loader.jobs, find_job(ctx, name));
+		job->lvl = lvl;
+		job->state = JOB_DONE;
+		free(name);
+		pthread_cond_broadcast(&loader.done);
+	}
+	pthread_mutex_unlock(&loader.lock);
+	return NULL;
+}
+
+/** \brief starts the worker on first use, the lock must be held 
+ * \return false if the thread couldn't be created */
+static bool loader_start(void)
+{
+	// a stop in progress still joins the old thread
+	while (loader.stop) {
+		pthread_cond_wait(&loader.done, &loader.lock);
+	}
+	if (loader.running)
+		return true;
+	if (pthread_create(&loader.thread, NULL, loader_main, NULL) != 0)
+		return false;
+	loader.jobs = bunlist_create(sizeof(async_job), 8, free_job);
+	loader.running = true;
+	return true;
+}
+
+/** \brief stops the running worker and destroys the levels nobody claimed, 
+ * the lock must be held and is released */
+static void loader_stop(void)
+{
+	loader.stop = true;
+	pthread_cond_signal(&loader.wake);
+	pthread_mutex_unlock(&loader.lock);
+
+	pthread_join(loader.thread, NULL);
+
+	pthread_mutex_lock(&loader.lock);
+	bunlist_destroy(loader.jobs);
+	loader.jobs = NULL;
+	loader.running = false;
+	loader.stop = false;
+	pthread_cond_broadcast(&loader.done);
+	pthread_mutex_unlock(&loader.lock);
+}
+
+/** \brief index of the job loading name with ctx, or -1, the lock must be held */
+static i64 find_job(ldtk_ctx *ctx, char *name)
+{
+	if (loader.jobs == NULL)
+		return -1;
+	for (u32 i = 0; i < loader.jobs->len; i++) {
+		async_job *job = bunlist_get(loader.jobs, i);
+		if (job->ctx == ctx && strcmp(job->name, name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/** \brief index of the first job in state, or -1, the lock must be held
+ * \param ctx only look at the jobs of ctx, or at every job if NULL */
+static i64 find_state(ldtk_ctx *ctx, JOB_STATE state)
+{
+	if (loader.jobs == NULL)
+		return -1;
+	for (u32 i = 0; i < loader.jobs->len; i++) {
+		async_job *job = bunlist_get(loader.jobs, i);
+		if ((ctx == NULL || job->ctx == ctx) && job->state == state)
+			return i;
+	}
+	return -1;
+}
+
+/** \brief frees the job, destroying its level if nobody claimed it */
+static void free_job(usize i, void *itm)
+{
+	async_job *job = itm;
+	if (job->lvl != NULL) {
+		ldtk_destroy_lvl(job->lvl);
+	}
+	free(job->name);
+}
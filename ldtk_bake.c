@@ -0,0 +1,640 @@
+/** ldtk_bake.c - compiles every level of the project
+* into one binary blob, and loads levels back from it
+* through mmap without parsing or copying */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ldtk.h"
+
+#define BAKE_MAGIC "LDTKBAK"
+#define BAKE_VERSION 7
+#define BAKE_ALIGN 8
+
+/** all offsets are from the start of the blob, 0 means NULL or empty.
+ * walls and tiles are stored as the raw structs, so a blob only loads
+ * in builds with the same struct layout, checked with wall_isize and tile_isize */
+typedef struct bake_header {
+	char magic[8];
+	u32 version;
+	u32 lvl_count;
+	u16 wall_isize, tile_isize;
+	u64 lvls; // bake_lvl table, in the order of the level index
+} bake_header;
+
+typedef struct bake_lvl {
+	u64 iid, identifier, bg_tile_path, fields; // strings, fields is json text
+	u64 field_block; // the ldtk_fields of the level, used in place
+	u64 walls, layers, ngbrs; // ldtk_wall, bake_layer and bake_ngbr arrays
+	u32 walls_len, layers_len, ngbrs_len;
+	ldtk_rect rect;
+	u16 wall_size;
+	u8 r, g, b;
+} bake_lvl;
+
+typedef struct bake_layer {
+	u64 identifier;
+	u64 content; // ldtk_tile, bake_ent or the tile columns
+	u64 grid; // intgrid layers: grid_w * grid_h i32 cells, 0 otherwise
+	u32 len;
+	u32 z;
+	i32 ox, oy; // packed layers: the level position
+	i32 grid_w, grid_h;
+	i32 tileset; // index into the tileset registry, -1 if none
+	u16 tilesize;
+	u8 type;
+	u8 packed; // content is laid out like ldtk_tile_cols, x, y, t, f
+} bake_layer;
+
+typedef struct bake_ent {
+	ldtk_rect rect;
+	u64 fields; // json text
+	u64 field_block; // ldtk_fields
+	u64 identifier, iid; // strings, the identifier is interned again on load
+	i32 def_uid;
+	f32 pivot_x, pivot_y;
+	u8 r, g, b;
+} bake_ent;
+
+typedef struct bake_ngbr {
+	u64 path;
+	u32 id;
+	char dir[3];
+} bake_ngbr;
+
+struct ldtk_baked {
+	u8 *map;
+	usize size;
+	bake_header *hdr;
+	bake_lvl *lvls;
+	bool drop_json; // the ctx has LDTK_LEVEL_DROP_JSON, the json text is not parsed
+	bunlist *tilesets; // the tileset registry of the ctx
+};
+
+static u64 put(bunlist *blob, void *data, usize size);
+static u64 put_str(bunlist *blob, const char *str);
+static u64 put_fields(bunlist *blob, json_object *fields);
+static u64 put_field_block(bunlist *blob, ldtk_fields *fields);
+static u64 put_walls(bunlist *blob, bunlist *walls);
+static u64 put_tiles(bunlist *blob, bunlist *tiles);
+static bool bake_lvl_data(bunlist *blob, ldtk_lvl *lvl, bake_lvl *rec);
+static u64 bake_layers(bunlist *blob, ldtk_lvl *lvl);
+static bool chk_range(ldtk_baked *baked, u64 off, u64 count, usize isize);
+static bool chk_str(ldtk_baked *baked, u64 off);
+static bool chk_lvl(ldtk_baked *baked, bake_lvl *rec);
+static bool chk_field_block(ldtk_baked *baked, u64 off);
+static char *map_str(ldtk_baked *baked, u64 off);
+static json_object *map_fields(ldtk_baked *baked, u64 off);
+static ldtk_fields *map_field_block(ldtk_baked *baked, u64 off);
+static bunlist *map_list(ldtk_baked *baked, bunarena *arena, u64 off,
+			 usize isize, usize len);
+static void map_layer(ldtk_baked *baked, ldtk_lvl *lvl, bake_layer *rec);
+
+bool ldtk_bake(char *path)
+{
+	return ldtk_bake_ctx(ldtk_get_ctx(), path);
+}
+
+bool ldtk_bake_ctx(ldtk_ctx *ctx, char *path)
+{
+	bunlist *index = ldtk_get_lvl_index_ctx(ctx);
+	if (index == NULL)
+		return false;
+
+	bunlist *blob = bunlist_create(1, 1 << 16, NULL);
+	bunlist *recs = bunlist_create(sizeof(bake_lvl), index->len, NULL);
+	bake_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	bool ok = put(blob, &hdr, sizeof(hdr)) != BARR_E_FULL;
+
+	for (u32 i = 0; ok && i < index->len; i++) {
+		ldtk_lvl_info *info = bunlist_get(index, i);
+		ldtk_lvl *lvl = ldtk_load_lvl_ctx(ctx, info->identifier);
+		if (lvl == NULL) {
+			ok = false;
+			break;
+		}
+		bake_lvl rec;
+		ok = bake_lvl_data(blob, lvl, &rec);
+		bunlist_append(recs, &rec);
+		ldtk_destroy_lvl(lvl);
+	}
+
+	if (ok) {
+		memcpy(hdr.magic, BAKE_MAGIC, sizeof(BAKE_MAGIC));
+		hdr.version = BAKE_VERSION;
+		hdr.lvl_count = recs->len;
+		hdr.wall_isize = sizeof(ldtk_wall);
+		hdr.tile_isize = sizeof(ldtk_tile);
+		hdr.lvls = put(blob, recs->items, recs->len * sizeof(bake_lvl));
+		ok = hdr.lvls != BARR_E_FULL;
+	}
+
+	// a blob missing any array is never written, its offsets would be wrong
+	if (ok) {
+		memcpy(blob->items, &hdr, sizeof(hdr));
+		FILE *f = fopen(path, "wb");
+		ok = f != NULL && fwrite(blob->items, 1, blob->len, f) == blob->len;
+		if (f != NULL && fclose(f) != 0)
+			ok = false;
+	}
+
+	bunlist_destroy(recs);
+	bunlist_destroy(blob);
+	return ok;
+}
+
+ldtk_baked *ldtk_baked_open(char *path)
+{
+	return ldtk_baked_open_ctx(ldtk_get_ctx(), path);
+}
+
+ldtk_baked *ldtk_baked_open_ctx(ldtk_ctx *ctx, char *path)
+{
+	i32 fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (usize)st.st_size < sizeof(bake_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	// private so nothing written to it reaches the file, but every level
+	// loaded from it shares the pages. edits go to copies in the level
+	u8 *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		       fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	ldtk_baked *baked = malloc(sizeof(ldtk_baked));
+	baked->map = map;
+	baked->size = st.st_size;
+	baked->hdr = (bake_header *)map;
+	baked->lvls = (bake_lvl *)(map + baked->hdr->lvls);
+	baked->drop_json = (ctx->flags & LDTK_LEVEL_DROP_JSON) != 0;
+	baked->tilesets = ctx->tilesets;
+
+	// the blob must match the build and the project loaded in ctx
+	bake_header *hdr = baked->hdr;
+	bunlist *index = ldtk_get_lvl_index_ctx(ctx);
+	bool ok = memcmp(hdr->magic, BAKE_MAGIC, sizeof(BAKE_MAGIC)) == 0 &&
+		  hdr->version == BAKE_VERSION &&
+		  hdr->wall_isize == sizeof(ldtk_wall) &&
+		  hdr->tile_isize == sizeof(ldtk_tile) && index != NULL &&
+		  hdr->lvl_count == index->len &&
+		  chk_range(baked, hdr->lvls, hdr->lvl_count, sizeof(bake_lvl));
+	for (u32 i = 0; ok && i < hdr->lvl_count; i++) {
+		ldtk_lvl_info *info = bunlist_get(index, i);
+		ok = chk_lvl(baked, &baked->lvls[i]) &&
+		     strcmp(map_str(baked, baked->lvls[i].iid), info->iid) == 0;
+	}
+
+	if (!ok) {
+		ldtk_baked_close(baked);
+		return NULL;
+	}
+	return baked;
+}
+
+void ldtk_baked_close(ldtk_baked *baked)
+{
+	munmap(baked->map, baked->size);
+	free(baked);
+}
+
+ldtk_lvl *ldtk_baked_lvl(ldtk_baked *baked, u32 i)
+{
+	if (i >= baked->hdr->lvl_count)
+		return NULL;
+	bake_lvl *rec = &baked->lvls[i];
+
+	// only the small headers are allocated, the big arrays point into the map
+	bunarena *arena = bunarena_create(4096);
+	ldtk_lvl *lvl = bunarena_calloc(arena, sizeof(ldtk_lvl));
+	lvl->arena = arena;
+	if (!baked->drop_json) {
+		lvl->json_refs = json_object_new_array();
+		lvl->custom_fields = map_fields(baked, rec->fields);
+	}
+	lvl->rect = rec->rect;
+	lvl->wall_size = rec->wall_size;
+	lvl->r = rec->r;
+	lvl->g = rec->g;
+	lvl->b = rec->b;
+	lvl->id = map_str(baked, rec->iid);
+	lvl->path = map_str(baked, rec->identifier);
+	lvl->bg_tile_path = map_str(baked, rec->bg_tile_path);
+	lvl->fields = map_field_block(baked, rec->field_block);
+	lvl->walls = map_list(baked, arena, rec->walls, sizeof(ldtk_wall),
+			      rec->walls_len);
+
+	lvl->ngbrs = bunlist_create_arena(arena, sizeof(ldtk_ngbr),
+					  rec->ngbrs_len, NULL);
+	bake_ngbr *ngbrs = (bake_ngbr *)(baked->map + rec->ngbrs);
+	for (u32 j = 0; j < rec->ngbrs_len; j++) {
+		ldtk_ngbr ngbr = { .path = map_str(baked, ngbrs[j].path),
+				   .id = ngbrs[j].id };
+		memcpy(ngbr.dir, ngbrs[j].dir, sizeof(ngbr.dir));
+		bunlist_append(lvl->ngbrs, &ngbr);
+	}
+
+	lvl->layers = bunlist_create_arena(arena, sizeof(ldtk_layer),
+					   rec->layers_len, NULL);
+	bake_layer *layers = (bake_layer *)(baked->map + rec->layers);
+	for (u32 j = 0; j < rec->layers_len; j++) {
+		map_layer(baked, lvl, &layers[j]);
+	}
+	return lvl;
+}
+
+/** \brief appends size bytes of data to the blob, aligned to BAKE_ALIGN
+ * \return the offset of the data in the blob, or BARR_E_FULL if the blob
+ * couldn't grow. every put_ function below passes it on */
+static u64 put(bunlist *blob, void *data, usize size)
+{
+	static const u8 zeros[BAKE_ALIGN] = { 0 };
+	usize pad = (BAKE_ALIGN - blob->len % BAKE_ALIGN) % BAKE_ALIGN;
+	if (pad > 0 && bunlist_append_n(blob, (void *)zeros, pad) == BARR_E_FULL)
+		return BARR_E_FULL;
+	return bunlist_append_n(blob, data, size);
+}
+
+static u64 put_str(bunlist *blob, const char *str)
+{
+	if (str == NULL)
+		return 0;
+	return put(blob, (void *)str, strlen(str) + 1);
+}
+
+/** \brief stores the fields as json text, the only part of a level that
+ * still gets parsed on load since the rest of the api hands out json_object */
+static u64 put_fields(bunlist *blob, json_object *fields)
+{
+	if (fields == NULL || json_object_array_length(fields) == 0)
+		return 0;
+	return put_str(blob, json_object_to_json_string_ext(
+				     fields, JSON_C_TO_STRING_PLAIN));
+}
+
+/** \brief the decoded fields have no pointers, so they are stored as they are */
+static u64 put_field_block(bunlist *blob, ldtk_fields *fields)
+{
+	if (fields == NULL)
+		return 0;
+	return put(blob, fields, fields->size);
+}
+
+/** \brief the walls are copied member by member into zeroed records,
+ * so their padding is 0 and baking the same project gives the same blob */
+static u64 put_walls(bunlist *blob, bunlist *walls)
+{
+	if (walls->len == 0)
+		return 0;
+	ldtk_wall *recs = calloc(walls->len, sizeof(ldtk_wall));
+	if (recs == NULL)
+		return BARR_E_FULL;
+	for (u32 i = 0; i < walls->len; i++) {
+		ldtk_wall *wall = bunlist_get(walls, i);
+		recs[i].bb = wall->bb;
+		recs[i].type = wall->type;
+		recs[i].layer = wall->layer;
+	}
+	u64 off = put(blob, recs, walls->len * sizeof(ldtk_wall));
+	free(recs);
+	return off;
+}
+
+/** \brief like put_walls, for the tiles of a layer */
+static u64 put_tiles(bunlist *blob, bunlist *tiles)
+{
+	if (tiles->len == 0)
+		return 0;
+	ldtk_tile *recs = calloc(tiles->len, sizeof(ldtk_tile));
+	if (recs == NULL)
+		return BARR_E_FULL;
+	for (u32 i = 0; i < tiles->len; i++) {
+		ldtk_tile *tile = bunlist_get(tiles, i);
+		recs[i].rect = tile->rect;
+		recs[i].t = tile->t;
+		recs[i].f = tile->f;
+	}
+	u64 off = put(blob, recs, tiles->len * sizeof(ldtk_tile));
+	free(recs);
+	return off;
+}
+
+/** \brief writes the arrays of the level and fills rec with their offsets
+ * \return false if the blob couldn't hold them */
+static bool bake_lvl_data(bunlist *blob, ldtk_lvl *lvl, bake_lvl *rec)
+{
+	memset(rec, 0, sizeof(bake_lvl));
+	rec->iid = put_str(blob, lvl->id);
+	rec->identifier = put_str(blob, lvl->path);
+	rec->bg_tile_path = put_str(blob, lvl->bg_tile_path);
+	rec->fields = put_fields(blob, lvl->custom_fields);
+	rec->field_block = put_field_block(blob, lvl->fields);
+	rec->rect = lvl->rect;
+	rec->wall_size = lvl->wall_size;
+	rec->r = lvl->r;
+	rec->g = lvl->g;
+	rec->b = lvl->b;
+
+	rec->walls_len = lvl->walls->len;
+	rec->walls = put_walls(blob, lvl->walls);
+
+	u64 offs[] = { rec->iid,    rec->identifier,  rec->bg_tile_path,
+		       rec->fields, rec->field_block, rec->walls };
+	bool ok = true;
+	for (u32 i = 0; i < sizeof(offs) / sizeof(offs[0]); i++) {
+		if (offs[i] == BARR_E_FULL)
+			ok = false;
+	}
+
+	bunlist *ngbrs = bunlist_create(sizeof(bake_ngbr), lvl->ngbrs->len,
+					NULL);
+	for (u32 i = 0; i < lvl->ngbrs->len; i++) {
+		ldtk_ngbr *ngbr_i = bunlist_get(lvl->ngbrs, i);
+		bake_ngbr ngbr;
+		memset(&ngbr, 0, sizeof(ngbr));
+		ngbr.path = put_str(blob, ngbr_i->path);
+		if (ngbr.path == BARR_E_FULL)
+			ok = false;
+		ngbr.id = ngbr_i->id;
+		memcpy(ngbr.dir, ngbr_i->dir, sizeof(ngbr.dir));
+		bunlist_append(ngbrs, &ngbr);
+	}
+	rec->ngbrs_len = ngbrs->len;
+	if (ngbrs->len > 0) {
+		rec->ngbrs =
+			put(blob, ngbrs->items, ngbrs->len * sizeof(bake_ngbr));
+		if (rec->ngbrs == BARR_E_FULL)
+			ok = false;
+	}
+	bunlist_destroy(ngbrs);
+
+	rec->layers_len = lvl->layers->len;
+	rec->layers = bake_layers(blob, lvl);
+	return ok && rec->layers != BARR_E_FULL;
+}
+
+/** \brief writes the content of every layer, then the bake_layer table
+ * \return offset of the table, or BARR_E_FULL if any of it didn't fit */
+static u64 bake_layers(bunlist *blob, ldtk_lvl *lvl)
+{
+	bunlist *recs = bunlist_create(sizeof(bake_layer), lvl->layers->len,
+				       NULL);
+	bool ok = true;
+	for (u32 i = 0; ok && i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		bake_layer rec;
+		memset(&rec, 0, sizeof(rec));
+		rec.identifier = put_str(blob, layer->identifier);
+		rec.tileset = layer->tileset;
+		rec.z = layer->z;
+		rec.tilesize = layer->tilesize;
+		rec.type = layer->type;
+		if (layer->grid != NULL) {
+			rec.grid_w = layer->grid->w;
+			rec.grid_h = layer->grid->h;
+			rec.grid = put(blob, layer->grid->cells,
+				       sizeof(i32) * rec.grid_w * rec.grid_h);
+		}
+
+		if (layer->cols != NULL) {
+			// the columns are contiguous after the header
+			rec.packed = true;
+			rec.len = layer->cols->len;
+			rec.ox = layer->cols->ox;
+			rec.oy = layer->cols->oy;
+			rec.content = put(blob, layer->cols->x,
+					  rec.len * (3 * sizeof(u16) + 1));
+		} else if (layer->type == LDTK_LAYER_ENTITY) {
+			bunlist *ents = bunlist_create(
+				sizeof(bake_ent), layer->content->len, NULL);
+			for (u32 j = 0; j < layer->content->len; j++) {
+				ldtk_ent *ent_j = bunlist_get(layer->content, j);
+				bake_ent ent;
+				memset(&ent, 0, sizeof(ent));
+				ent.rect = ent_j->rect;
+				ent.fields = put_fields(blob, ent_j->custom_fields);
+				ent.field_block =
+					put_field_block(blob, ent_j->fields);
+				ent.identifier = put_str(blob, ent_j->identifier);
+				ent.iid = put_str(blob, ent_j->iid);
+				if (ent.fields == BARR_E_FULL ||
+				    ent.field_block == BARR_E_FULL ||
+				    ent.identifier == BARR_E_FULL ||
+				    ent.iid == BARR_E_FULL)
+					ok = false;
+				ent.def_uid = ent_j->def_uid;
+				ent.pivot_x = ent_j->pivot_x;
+				ent.pivot_y = ent_j->pivot_y;
+				ent.r = ent_j->r;
+				ent.g = ent_j->g;
+				ent.b = ent_j->b;
+				bunlist_append(ents, &ent);
+			}
+			rec.len = ents->len;
+			rec.content = put(blob, ents->items,
+					  ents->len * sizeof(bake_ent));
+			bunlist_destroy(ents);
+		} else {
+			rec.len = layer->content->len;
+			rec.content = put_tiles(blob, layer->content);
+		}
+		if (rec.identifier == BARR_E_FULL || rec.grid == BARR_E_FULL ||
+		    rec.content == BARR_E_FULL)
+			ok = false;
+		bunlist_append(recs, &rec);
+	}
+
+	u64 off = ok ? put(blob, recs->items, recs->len * sizeof(bake_layer)) :
+		       BARR_E_FULL;
+	bunlist_destroy(recs);
+	return off;
+}
+
+/** \brief true if count items of isize bytes at off are inside the map */
+static bool chk_range(ldtk_baked *baked, u64 off, u64 count, usize isize)
+{
+	if (count == 0)
+		return true;
+	return off >= sizeof(bake_header) && off % BAKE_ALIGN == 0 &&
+	       off <= baked->size && count <= (baked->size - off) / isize;
+}
+
+/** \brief true if off is NULL or a null terminated string inside the map */
+static bool chk_str(ldtk_baked *baked, u64 off)
+{
+	if (off == 0)
+		return true;
+	return off < baked->size &&
+	       memchr(baked->map + off, '\0', baked->size - off) != NULL;
+}
+
+/** \brief checks every offset of the level, so loading never reads
+ * outside of the map even if the file was cut short */
+static bool chk_lvl(ldtk_baked *baked, bake_lvl *rec)
+{
+	if (rec->iid == 0 || !chk_str(baked, rec->iid) ||
+	    !chk_str(baked, rec->identifier) ||
+	    !chk_str(baked, rec->bg_tile_path) ||
+	    !chk_str(baked, rec->fields) ||
+	    !chk_field_block(baked, rec->field_block) ||
+	    !chk_range(baked, rec->walls, rec->walls_len, sizeof(ldtk_wall)) ||
+	    !chk_range(baked, rec->ngbrs, rec->ngbrs_len, sizeof(bake_ngbr)) ||
+	    !chk_range(baked, rec->layers, rec->layers_len,
+		       sizeof(bake_layer)))
+		return false;
+
+	bake_ngbr *ngbrs = (bake_ngbr *)(baked->map + rec->ngbrs);
+	for (u32 i = 0; i < rec->ngbrs_len; i++) {
+		if (!chk_str(baked, ngbrs[i].path))
+			return false;
+	}
+
+	bake_layer *layers = (bake_layer *)(baked->map + rec->layers);
+	for (u32 i = 0; i < rec->layers_len; i++) {
+		bake_layer *l = &layers[i];
+		usize isize = l->packed		     ? 3 * sizeof(u16) + 1 :
+			      l->type == LDTK_LAYER_ENTITY ? sizeof(bake_ent) :
+							     sizeof(ldtk_tile);
+		if (!chk_str(baked, l->identifier) ||
+		    l->tileset < -1 || l->tileset >= (i32)baked->tilesets->len ||
+		    !chk_range(baked, l->content, l->len, isize) ||
+		    l->grid_w < 0 || l->grid_h < 0 ||
+		    !chk_range(baked, l->grid, (u64)l->grid_w * l->grid_h,
+			       sizeof(i32)))
+			return false;
+		if (l->type != LDTK_LAYER_ENTITY || l->packed)
+			continue;
+		bake_ent *ents = (bake_ent *)(baked->map + l->content);
+		for (u32 j = 0; j < l->len; j++) {
+			if (!chk_str(baked, ents[j].fields) ||
+			    !chk_str(baked, ents[j].identifier) ||
+			    !chk_str(baked, ents[j].iid) ||
+			    !chk_field_block(baked, ents[j].field_block))
+				return false;
+		}
+	}
+	return true;
+}
+
+/** \brief true if off is NULL or a valid ldtk_fields inside the map */
+static bool chk_field_block(ldtk_baked *baked, u64 off)
+{
+	if (off == 0)
+		return true;
+	return chk_range(baked, off, 1, sizeof(ldtk_fields)) &&
+	       ldtk_fields_valid((ldtk_fields *)(baked->map + off),
+				 baked->size - off);
+}
+
+static char *map_str(ldtk_baked *baked, u64 off)
+{
+	return off == 0 ? NULL : (char *)(baked->map + off);
+}
+
+static json_object *map_fields(ldtk_baked *baked, u64 off)
+{
+	if (off == 0)
+		return json_object_new_array();
+	return json_tokener_parse(map_str(baked, off));
+}
+
+static ldtk_fields *map_field_block(ldtk_baked *baked, u64 off)
+{
+	return off == 0 ? NULL : (ldtk_fields *)(baked->map + off);
+}
+
+/** \brief a subarray over len items at off, it never owns its items */
+static bunlist *map_list(ldtk_baked *baked, bunarena *arena, u64 off,
+			 usize isize, usize len)
+{
+	bunlist *list = bunlist_create_arena(arena, isize, 0, NULL);
+	list->subarr = true;
+	list->items = len > 0 ? baked->map + off : NULL;
+	list->len = len;
+	list->cap = len;
+	return list;
+}
+
+/** \brief appends the layer rec to the level */
+static void map_layer(ldtk_baked *baked, ldtk_lvl *lvl, bake_layer *rec)
+{
+	ldtk_tileset *ts = rec->tileset >= 0 ?
+				   bunlist_get(baked->tilesets, rec->tileset) :
+				   NULL;
+	ldtk_layer layer = { .identifier = map_str(baked, rec->identifier),
+			     .tileset_path = ts != NULL ? ts->path : NULL,
+			     .tileset = rec->tileset,
+			     .composite = NULL,
+			     .cols = NULL,
+			     .grid = NULL,
+			     .chunks = NULL,
+			     .type = rec->type,
+			     .z = rec->z,
+			     .tilesize = rec->tilesize };
+
+	if (rec->grid != 0) {
+		// the map is shared by every load of the level,
+		// ldtk_set_intgrid_rect copies the cells before editing them
+		ldtk_grid *grid = bunarena_alloc(lvl->arena, sizeof(ldtk_grid));
+		grid->w = rec->grid_w;
+		grid->h = rec->grid_h;
+		grid->cells = (i32 *)(baked->map + rec->grid);
+		grid->baked = true;
+		layer.grid = grid;
+	}
+
+	if (rec->packed) {
+		ldtk_tile_cols *cols =
+			bunarena_alloc(lvl->arena, sizeof(ldtk_tile_cols));
+		cols->len = rec->len;
+		cols->ox = rec->ox;
+		cols->oy = rec->oy;
+		cols->x = (u16 *)(baked->map + rec->content);
+		cols->y = cols->x + rec->len;
+		cols->t = cols->y + rec->len;
+		cols->f = (u8 *)(cols->t + rec->len);
+		layer.cols = cols;
+		layer.content = map_list(baked, lvl->arena, 0, sizeof(ldtk_tile),
+					 0);
+	} else if (rec->type == LDTK_LAYER_ENTITY) {
+		layer.content = bunlist_create_arena(lvl->arena, sizeof(ldtk_ent),
+						     rec->len, NULL);
+		bake_ent *ents = (bake_ent *)(baked->map + rec->content);
+		for (u32 i = 0; i < rec->len; i++) {
+			ldtk_ent ent = { .rect = ents[i].rect,
+					 .fields = map_field_block(
+						 baked, ents[i].field_block),
+					 .identifier = map_str(
+						 baked, ents[i].identifier),
+					 .iid = map_str(baked, ents[i].iid),
+					 .def_uid = ents[i].def_uid,
+					 .pivot_x = ents[i].pivot_x,
+					 .pivot_y = ents[i].pivot_y,
+					 .r = ents[i].r,
+					 .g = ents[i].g,
+					 .b = ents[i].b };
+			if (!baked->drop_json) {
+				// json_refs owns the fields, like in arena mode
+				ent.custom_fields =
+					map_fields(baked, ents[i].fields);
+				json_object_array_add(lvl->json_refs,
+						      ent.custom_fields);
+			}
+			bunlist_append(layer.content, &ent);
+		}
+	} else {
+		layer.content = map_list(baked, lvl->arena, rec->content,
+					 sizeof(ldtk_tile), rec->len);
+	}
+	bunlist_append(lvl->layers, &layer);
+}
@@ -0,0 +1,468 @@
+/** ldtk_bvh.c - bounding volume hierarchy
+* over the walls of a level, built with a binned SAH
+* when LDTK_LEVEL_BVH is enabled */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ldtk.h"
+
+#define BVH_BINS 16
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_LEAF 16
+#define BVH_SAH_DEPTH 32 // deeper nodes use median splits, bounding the depth
+#define BVH_STACK 72
+
+typedef struct bvh_bin {
+	f32 min_x, min_y, max_x, max_y;
+	u32 count;
+} bvh_bin;
+
+typedef struct bvh_ray {
+	f32 ox, oy, dx, dy;
+	f32 inv_x, inv_y;
+	f32 ex, ey; // size of the swept box, 0 for rays
+} bvh_ray;
+
+static void build_node(ldtk_bvh *bvh, f32 *boxes, u32 node, u32 start,
+		       u32 count, u32 depth);
+static bool split_sah(ldtk_bvh_node *n, f32 *boxes, u32 *idx, u32 count,
+		      u32 *mid);
+static void split_median(f32 *boxes, u32 *idx, u32 count, bool axis_x,
+			 u32 *mid);
+static f32 centroid(f32 *box, bool axis_x);
+static f32 half_perimeter(f32 min_x, f32 min_y, f32 max_x, f32 max_y);
+static void bin_grow(bvh_bin *bin, f32 *box);
+static void bin_merge(bvh_bin *bin, bvh_bin *other);
+static bool ray_box(bvh_ray *ray, f32 *box, bool strict, f32 max_t,
+		   f32 *t_min, i32 *axis);
+static bool bvh_cast(ldtk_lvl *lvl, bvh_ray *ray, ldtk_hit *hit);
+static ldtk_bvh *fresh_bvh(ldtk_lvl *lvl);
+
+ldtk_bvh *ldtk_bvh_build(ldtk_lvl *lvl)
+{
+	ldtk_bvh *bvh = malloc(sizeof(ldtk_bvh));
+	u32 n = lvl->walls->len;
+
+	// a binary tree with n leafs has at most 2n - 1 nodes
+	bvh->nodes = malloc(sizeof(ldtk_bvh_node) * (n > 0 ? 2 * n - 1 : 1));
+	bvh->wall_idx = malloc(sizeof(u32) * (n > 0 ? n : 1));
+	bvh->boxes = malloc(sizeof(f32) * 4 * (n > 0 ? n : 1));
+	bvh->node_count = 1;
+	bvh->dirty = false;
+
+	f32 *boxes = malloc(sizeof(f32) * 4 * (n > 0 ? n : 1));
+	for (u32 i = 0; i < n; i++) {
+		ldtk_rect rect = ldtk_wall_px(lvl, bunlist_get(lvl->walls, i));
+		boxes[i * 4 + 0] = rect.x;
+		boxes[i * 4 + 1] = rect.y;
+		boxes[i * 4 + 2] = rect.x + rect.w;
+		boxes[i * 4 + 3] = rect.y + rect.h;
+		bvh->wall_idx[i] = i;
+	}
+
+	build_node(bvh, boxes, 0, 0, n, 0);
+
+	// store the boxes in leaf order, so a leaf reads one contiguous block
+	for (u32 i = 0; i < n; i++) {
+		memcpy(&bvh->boxes[i * 4], &boxes[bvh->wall_idx[i] * 4],
+		       sizeof(f32) * 4);
+	}
+	free(boxes);
+	return bvh;
+}
+
+void ldtk_bvh_destroy(ldtk_bvh *bvh)
+{
+	free(bvh->nodes);
+	free(bvh->boxes);
+	free(bvh->wall_idx);
+	free(bvh);
+}
+
+u32 ldtk_bvh_query(ldtk_lvl *lvl, ldtk_rect area, bunlist *out)
+{
+	ldtk_bvh *bvh = fresh_bvh(lvl);
+	if (bvh == NULL || lvl->walls->len == 0)
+		return 0;
+
+	f32 a[4] = { area.x, area.y, area.x + area.w, area.y + area.h };
+	u32 stack[BVH_STACK];
+	u32 top = 0;
+	u32 found = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		ldtk_bvh_node *n = &bvh->nodes[stack[--top]];
+		if (n->min_x >= a[2] || a[0] >= n->max_x || n->min_y >= a[3] ||
+		    a[1] >= n->max_y)
+			continue;
+
+		if (n->count == 0) {
+			stack[top++] = n->start;
+			stack[top++] = n->start + 1;
+			continue;
+		}
+		for (u32 i = n->start; i < n->start + n->count; i++) {
+			f32 *b = &bvh->boxes[i * 4];
+			if (b[0] < a[2] && a[0] < b[2] && b[1] < a[3] &&
+			    a[1] < b[3]) {
+				ldtk_wall *wall =
+					bunlist_get(lvl->walls, bvh->wall_idx[i]);
+				bunlist_append(out, &wall);
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
+bool ldtk_bvh_raycast(ldtk_lvl *lvl, f32 x, f32 y, f32 dx, f32 dy,
+		      ldtk_hit *hit)
+{
+	bvh_ray ray = { x, y, dx, dy, 1.0f / dx, 1.0f / dy, 0, 0 };
+	return bvh_cast(lvl, &ray, hit);
+}
+
+bool ldtk_bvh_sweep(ldtk_lvl *lvl, ldtk_rect box, f32 dx, f32 dy,
+		    ldtk_hit *hit)
+{
+	// casting the top left corner against every wall grown by the box
+	// size to the top and left is the same as moving the whole box
+	bvh_ray ray = { box.x, box.y, dx, dy, 1.0f / dx, 1.0f / dy, box.w, box.h };
+	return bvh_cast(lvl, &ray, hit);
+}
+
+/** \brief builds node over the items start to start + count,
+ * children are allocated as a pair so the right child is always start + 1 */
+static void build_node(ldtk_bvh *bvh, f32 *boxes, u32 node, u32 start,
+		       u32 count, u32 depth)
+{
+	ldtk_bvh_node *n = &bvh->nodes[node];
+	u32 *idx = &bvh->wall_idx[start];
+	n->min_x = n->min_y = 0;
+	n->max_x = n->max_y = 0;
+	for (u32 i = 0; i < count; i++) {
+		f32 *b = &boxes[idx[i] * 4];
+		if (i == 0 || b[0] < n->min_x)
+			n->min_x = b[0];
+		if (i == 0 || b[1] < n->min_y)
+			n->min_y = b[1];
+		if (i == 0 || b[2] > n->max_x)
+			n->max_x = b[2];
+		if (i == 0 || b[3] > n->max_y)
+			n->max_y = b[3];
+	}
+	n->start = start;
+	n->count = count;
+	if (count <= BVH_LEAF_SIZE)
+		return;
+
+	u32 mid = 0;
+	if (depth < BVH_SAH_DEPTH) {
+		if (!split_sah(n, boxes, idx, count, &mid))
+			return;
+	} else {
+		split_median(boxes, idx, count,
+			     n->max_x - n->min_x >= n->max_y - n->min_y, &mid);
+	}
+
+	u32 left = bvh->node_count;
+	bvh->node_count += 2;
+	n->start = left;
+	n->count = 0;
+	build_node(bvh, boxes, left, start, mid, depth + 1);
+	build_node(bvh, boxes, left + 1, start + mid, count - mid, depth + 1);
+}
+
+/** \brief bins the item centroids on both axes and partitions idx at the
+ * cheapest plane, walls are 2d so the surface area is the half perimeter
+ * \return false if keeping the node as a leaf is cheaper */
+static bool split_sah(ldtk_bvh_node *n, f32 *boxes, u32 *idx, u32 count,
+		      u32 *mid)
+{
+	f32 best_cost = half_perimeter(n->min_x, n->min_y, n->max_x,
+				       n->max_y) *
+			count;
+	i32 best_axis = -1;
+	u32 best_bin = 0;
+	f32 c_min[2], scale[2];
+
+	for (i32 axis = 0; axis < 2; axis++) {
+		c_min[axis] = centroid(&boxes[idx[0] * 4], axis == 0);
+		f32 c_max = c_min[axis];
+		for (u32 i = 1; i < count; i++) {
+			f32 c = centroid(&boxes[idx[i] * 4], axis == 0);
+			c_min[axis] = c < c_min[axis] ? c : c_min[axis];
+			c_max = c > c_max ? c : c_max;
+		}
+		if (c_max <= c_min[axis]) {
+			scale[axis] = 0;
+			continue;
+		}
+		scale[axis] = BVH_BINS / (c_max - c_min[axis]);
+
+		bvh_bin bins[BVH_BINS] = { 0 };
+		for (u32 i = 0; i < count; i++) {
+			f32 *b = &boxes[idx[i] * 4];
+			i32 bin = (centroid(b, axis == 0) - c_min[axis]) *
+				  scale[axis];
+			bin = bin < BVH_BINS ? bin : BVH_BINS - 1;
+			bin_grow(&bins[bin], b);
+		}
+
+		// sweep from the right storing the cost of each right side,
+		// then from the left adding the left side
+		f32 right_cost[BVH_BINS];
+		bvh_bin acc = { 0 };
+		for (i32 i = BVH_BINS - 1; i > 0; i--) {
+			bin_merge(&acc, &bins[i]);
+			right_cost[i] = acc.count == 0 ?
+						0 :
+						half_perimeter(acc.min_x,
+							       acc.min_y,
+							       acc.max_x,
+							       acc.max_y) *
+							acc.count;
+		}
+		memset(&acc, 0, sizeof(acc));
+		for (i32 i = 0; i < BVH_BINS - 1; i++) {
+			bin_merge(&acc, &bins[i]);
+			if (acc.count == 0 || acc.count == count)
+				continue;
+			f32 cost = half_perimeter(acc.min_x, acc.min_y,
+						  acc.max_x, acc.max_y) *
+					   acc.count +
+				   right_cost[i + 1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = i;
+			}
+		}
+	}
+
+	if (best_axis == -1) {
+		if (count <= BVH_MAX_LEAF)
+			return false;
+		// every split costs more, but the leaf would be too big
+		split_median(boxes, idx, count,
+			     n->max_x - n->min_x >= n->max_y - n->min_y, mid);
+		return true;
+	}
+
+	u32 l = 0, r = count;
+	while (l < r) {
+		i32 bin = (centroid(&boxes[idx[l] * 4], best_axis == 0) -
+			   c_min[best_axis]) *
+			  scale[best_axis];
+		bin = bin < BVH_BINS ? bin : BVH_BINS - 1;
+		if (bin <= (i32)best_bin) {
+			l++;
+		} else {
+			u32 tmp = idx[l];
+			idx[l] = idx[--r];
+			idx[r] = tmp;
+		}
+	}
+	*mid = l;
+	return true;
+}
+
+/** \brief partitions idx around the median centroid on the given axis */
+static void split_median(f32 *boxes, u32 *idx, u32 count, bool axis_x,
+			 u32 *mid)
+{
+	// quickselect, the order inside each half does not matter
+	u32 k = count / 2;
+	u32 lo = 0, hi = count - 1;
+	while (lo < hi) {
+		u32 tmp = idx[(lo + hi) / 2];
+		idx[(lo + hi) / 2] = idx[hi];
+		idx[hi] = tmp;
+		f32 pivot = centroid(&boxes[idx[hi] * 4], axis_x);
+
+		u32 store = lo;
+		for (u32 i = lo; i < hi; i++) {
+			if (centroid(&boxes[idx[i] * 4], axis_x) < pivot) {
+				tmp = idx[i];
+				idx[i] = idx[store];
+				idx[store++] = tmp;
+			}
+		}
+		tmp = idx[store];
+		idx[store] = idx[hi];
+		idx[hi] = tmp;
+
+		if (store == k)
+			break;
+		if (k < store)
+			hi = store - 1;
+		else
+			lo = store + 1;
+	}
+	*mid = k;
+}
+
+static f32 centroid(f32 *box, bool axis_x)
+{
+	return axis_x ? (box[0] + box[2]) * 0.5f : (box[1] + box[3]) * 0.5f;
+}
+
+static f32 half_perimeter(f32 min_x, f32 min_y, f32 max_x, f32 max_y)
+{
+	return (max_x - min_x) + (max_y - min_y);
+}
+
+/** \brief grows bin to contain box, counting it as one more item */
+static void bin_grow(bvh_bin *bin, f32 *box)
+{
+	if (bin->count == 0) {
+		memcpy(&bin->min_x, box, sizeof(f32) * 4);
+	} else {
+		bin->min_x = box[0] < bin->min_x ? box[0] : bin->min_x;
+		bin->min_y = box[1] < bin->min_y ? box[1] : bin->min_y;
+		bin->max_x = box[2] > bin->max_x ? box[2] : bin->max_x;
+		bin->max_y = box[3] > bin->max_y ? box[3] : bin->max_y;
+	}
+	bin->count++;
+}
+
+/** \brief grows bin to contain other and all of its items */
+static void bin_merge(bvh_bin *bin, bvh_bin *other)
+{
+	if (other->count == 0)
+		return;
+	u32 count = bin->count;
+	bin_grow(bin, &other->min_x);
+	bin->count = count + other->count;
+}
+
+/** \brief slab test of the ray against box grown by the ray extent
+ * \param strict walls only touched, or touched at a corner, are not hit,
+ * nodes use the non strict test so they never miss a strict hit
+ * \param t_min time the ray enters the box, negative if it starts inside
+ * \param axis 0 if it enters through a x side, 1 for y */
+static bool ray_box(bvh_ray *ray, f32 *box, bool strict, f32 max_t,
+		   f32 *t_min, i32 *axis)
+{
+	f32 t0 = -1e30f, t1 = 1e30f;
+	*axis = -1;
+
+	f32 lo = box[0] - ray->ex, hi = box[2];
+	if (ray->dx == 0) {
+		if (strict ? (ray->ox <= lo || ray->ox >= hi) :
+			     (ray->ox < lo || ray->ox > hi))
+			return false;
+	} else {
+		f32 a = (lo - ray->ox) * ray->inv_x;
+		f32 b = (hi - ray->ox) * ray->inv_x;
+		t0 = a < b ? a : b;
+		t1 = a < b ? b : a;
+		*axis = 0;
+	}
+
+	lo = box[1] - ray->ey, hi = box[3];
+	if (ray->dy == 0) {
+		if (strict ? (ray->oy <= lo || ray->oy >= hi) :
+			     (ray->oy < lo || ray->oy > hi))
+			return false;
+	} else {
+		f32 a = (lo - ray->oy) * ray->inv_y;
+		f32 b = (hi - ray->oy) * ray->inv_y;
+		if ((a < b ? a : b) > t0 || *axis == -1) {
+			t0 = a < b ? a : b;
+			*axis = 1;
+		}
+		t1 = (a < b ? b : a) < t1 ? (a < b ? b : a) : t1;
+	}
+
+	*t_min = t0;
+	if (strict)
+		return t0 < t1 && t1 > 0 && t0 <= max_t;
+	return t0 <= t1 && t1 >= 0 && t0 <= max_t;
+}
+
+/** \brief finds the closest wall hit by ray, visiting the nearest child first
+ * so far away subtrees get culled by the best hit found so far */
+static bool bvh_cast(ldtk_lvl *lvl, bvh_ray *ray, ldtk_hit *hit)
+{
+	ldtk_bvh *bvh = fresh_bvh(lvl);
+	if (bvh == NULL || lvl->walls->len == 0)
+		return false;
+
+	u32 stack[BVH_STACK];
+	u32 top = 0;
+	f32 best = 1.0f;
+	i32 best_axis = -1;
+	u32 best_i = 0;
+	bool found = false;
+	f32 t;
+	i32 axis;
+
+	if (!ray_box(ray, &bvh->nodes[0].min_x, false, best, &t, &axis))
+		return false;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		ldtk_bvh_node *n = &bvh->nodes[stack[--top]];
+		if (n->count == 0) {
+			f32 tl, tr;
+			bool hl = ray_box(ray, &bvh->nodes[n->start].min_x,
+					  false, best, &tl, &axis);
+			bool hr = ray_box(ray, &bvh->nodes[n->start + 1].min_x,
+					  false, best, &tr, &axis);
+			// push the far child first so the near one pops first
+			if (hl && hr) {
+				stack[top++] = tl <= tr ? n->start + 1 :
+							  n->start;
+				stack[top++] = tl <= tr ? n->start :
+							  n->start + 1;
+			} else if (hl) {
+				stack[top++] = n->start;
+			} else if (hr) {
+				stack[top++] = n->start + 1;
+			}
+			continue;
+		}
+
+		for (u32 i = n->start; i < n->start + n->count; i++) {
+			if (!ray_box(ray, &bvh->boxes[i * 4], true, best, &t,
+				     &axis))
+				continue;
+			t = t > 0 ? t : 0;
+			if (!found || t < best) {
+				best = t;
+				best_axis = axis;
+				best_i = i;
+				found = true;
+			}
+		}
+	}
+
+	if (!found)
+		return false;
+
+	// the ray may have started inside the wall, then there's no side
+	f32 t_enter;
+	ray_box(ray, &bvh->boxes[best_i * 4], true, 1.0f, &t_enter, &axis);
+	hit->wall = bunlist_get(lvl->walls, bvh->wall_idx[best_i]);
+	hit->t = best;
+	hit->nx = 0;
+	hit->ny = 0;
+	if (t_enter >= 0 && best_axis == 0)
+		hit->nx = ray->dx > 0 ? -1 : 1;
+	if (t_enter >= 0 && best_axis == 1)
+		hit->ny = ray->dy > 0 ? -1 : 1;
+	return true;
+}
+
+/** \brief the bvh of the level, built again first if an edit left it
+ * dirty, so a burst of edits costs one build */
+static ldtk_bvh *fresh_bvh(ldtk_lvl *lvl)
+{
+	if (lvl->bvh != NULL && lvl->bvh->dirty) {
+		ldtk_bvh_destroy(lvl->bvh);
+		lvl->bvh = ldtk_bvh_build(lvl);
+	}
+	return lvl->bvh;
+}
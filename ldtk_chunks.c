@@ -0,0 +1,190 @@
+/** ldtk_chunks.c - the tiles of each tile layer as vertex
+* and index arrays split in square chunks, so a renderer only
+* touches the chunks in view, built when LDTK_LEVEL_CHUNKS is enabled */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ldtk.h"
+
+static u32 chunk_of(ldtk_chunks *chunks, i32 x, i32 y);
+static i32 chunk_clamp(i32 v, i32 chunk_px, i32 max);
+static void put_quad(ldtk_chunks *chunks, ldtk_tileset *tileset,
+		     ldtk_tile *tile, i32 size, u32 vert, u32 index);
+static bool rect_overlap(ldtk_rect a, ldtk_rect b);
+
+ldtk_chunks *ldtk_chunks_build(ldtk_lvl *lvl, ldtk_layer *layer,
+			       u32 chunk_size)
+{
+	// the tiles sit on the grid of the layer but are drawn at the
+	// size of the tileset, which can be larger or smaller
+	i32 grid = layer->tilesize > 0 ? layer->tilesize : 1;
+	ldtk_tileset *tileset = ldtk_layer_tileset(lvl, layer);
+	i32 size = tileset != NULL && tileset->tile_size > 0 ?
+			   tileset->tile_size :
+			   grid;
+	ldtk_chunks *chunks = malloc(sizeof(ldtk_chunks));
+	chunks->rect = lvl->rect;
+	chunks->chunk_px = (chunk_size > 0 ? chunk_size : 1) * grid;
+	chunks->tile_px = size;
+	chunks->cw = (lvl->rect.w + chunks->chunk_px - 1) / chunks->chunk_px;
+	chunks->ch = (lvl->rect.h + chunks->chunk_px - 1) / chunks->chunk_px;
+	chunks->cw = chunks->cw > 0 ? chunks->cw : 1;
+	chunks->ch = chunks->ch > 0 ? chunks->ch : 1;
+	u32 count = chunks->cw * chunks->ch;
+	u32 len = ldtk_layer_tile_count(layer);
+
+	// counting sort like ldtk_part_build, each tile goes to the chunk
+	// holding its top left corner and keeps its layer order in there
+	u32 *start = calloc(count + 1, sizeof(u32));
+	ldtk_tile tile;
+	for (u32 i = 0; i < len; i++) {
+		ldtk_layer_tile(layer, i, &tile);
+		start[chunk_of(chunks, tile.rect.x, tile.rect.y) + 1]++;
+	}
+	for (u32 c = 0; c < count; c++) {
+		start[c + 1] += start[c];
+	}
+
+	chunks->vert_count = len * 4;
+	chunks->index_count = len * 6;
+	chunks->verts = malloc(sizeof(ldtk_vertex) * (chunks->vert_count + 1));
+	chunks->indices = malloc(sizeof(u32) * (chunks->index_count + 1));
+	chunks->chunks = malloc(sizeof(ldtk_chunk) * count);
+	for (u32 c = 0; c < count; c++) {
+		ldtk_chunk *chunk = &chunks->chunks[c];
+		chunk->first_index = start[c] * 6;
+		chunk->index_count = 0;
+		chunk->rect = (ldtk_rect){ 0, 0, 0, 0 };
+	}
+
+	for (u32 i = 0; i < len; i++) {
+		ldtk_layer_tile(layer, i, &tile);
+		i32 x = tile.rect.x, y = tile.rect.y;
+		ldtk_chunk *chunk = &chunks->chunks[chunk_of(chunks, x, y)];
+		u32 slot = chunk->first_index / 6 + chunk->index_count / 6;
+		put_quad(chunks, tileset, &tile, size, slot * 4, slot * 6);
+
+		ldtk_rect *rect = &chunk->rect;
+		if (chunk->index_count == 0) {
+			*rect = (ldtk_rect){ x, y, size, size };
+		} else {
+			i32 x1 = rect->x + rect->w, y1 = rect->y + rect->h;
+			x1 = x + size > x1 ? x + size : x1;
+			y1 = y + size > y1 ? y + size : y1;
+			rect->x = x < rect->x ? x : rect->x;
+			rect->y = y < rect->y ? y : rect->y;
+			rect->w = x1 - rect->x;
+			rect->h = y1 - rect->y;
+		}
+		chunk->index_count += 6;
+	}
+	free(start);
+	return chunks;
+}
+
+void ldtk_chunks_destroy(ldtk_chunks *chunks)
+{
+	free(chunks->verts);
+	free(chunks->indices);
+	free(chunks->chunks);
+	free(chunks);
+}
+
+u32 ldtk_visible_chunks(ldtk_layer *layer, ldtk_rect view, bunlist *out)
+{
+	ldtk_chunks *chunks = layer->chunks;
+	if (chunks == NULL)
+		return 0;
+
+	// a tile sticks out of its chunk by up to one tile,
+	// so the chunks left of and above the view can reach into it
+	i32 pad = chunks->tile_px;
+	i32 vx = view.x - chunks->rect.x, vy = view.y - chunks->rect.y;
+	i32 w = view.w > 0 ? view.w : 1, h = view.h > 0 ? view.h : 1;
+	i32 x0 = chunk_clamp(vx - pad, chunks->chunk_px, chunks->cw);
+	i32 y0 = chunk_clamp(vy - pad, chunks->chunk_px, chunks->ch);
+	i32 x1 = chunk_clamp(vx + w - 1, chunks->chunk_px, chunks->cw);
+	i32 y1 = chunk_clamp(vy + h - 1, chunks->chunk_px, chunks->ch);
+
+	u32 found = 0;
+	for (i32 y = y0; y <= y1; y++) {
+		for (i32 x = x0; x <= x1; x++) {
+			ldtk_chunk *chunk = &chunks->chunks[y * chunks->cw + x];
+			if (chunk->index_count == 0 ||
+			    !rect_overlap(chunk->rect, view))
+				continue;
+			bunlist_append(out, &chunk);
+			found++;
+		}
+	}
+	return found;
+}
+
+/** \brief index of the chunk holding the pixel x, y,
+ * tiles outside of the level end up in the border chunks */
+static u32 chunk_of(ldtk_chunks *chunks, i32 x, i32 y)
+{
+	i32 cx = chunk_clamp(x - chunks->rect.x, chunks->chunk_px, chunks->cw);
+	i32 cy = chunk_clamp(y - chunks->rect.y, chunks->chunk_px, chunks->ch);
+	return cy * chunks->cw + cx;
+}
+
+/** \brief the chunk of the pixel v, clamped to [0, max) */
+static i32 chunk_clamp(i32 v, i32 chunk_px, i32 max)
+{
+	// round towards negative infinity so -1 isn't chunk 0
+	i32 c = v >= 0 ? v / chunk_px : -((-v + chunk_px - 1) / chunk_px);
+	if (c < 0)
+		return 0;
+	if (c >= max)
+		return max - 1;
+	return c;
+}
+
+/** \brief writes the 4 corners of the tile at vert, clockwise from the top
+ * left, and its 2 triangles at index. the uvs come from the table of the 
+ * tileset, 0 if the tile isn't in it. flipping swaps the uv sides */
+static void put_quad(ldtk_chunks *chunks, ldtk_tileset *tileset,
+		     ldtk_tile *tile, i32 size, u32 vert, u32 index)
+{
+	f32 x0 = tile->rect.x, y0 = tile->rect.y;
+	f32 x1 = x0 + size, y1 = y0 + size;
+	f32 u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+	if (tileset != NULL && tile->t < (u32)(tileset->cw * tileset->ch)) {
+		f32 *uv = &tileset->uvs[tile->t * 4];
+		u0 = uv[0];
+		v0 = uv[1];
+		u1 = uv[2];
+		v1 = uv[3];
+	}
+	if (tile->f & 1) {
+		f32 u = u0;
+		u0 = u1;
+		u1 = u;
+	}
+	if (tile->f & 2) {
+		f32 v = v0;
+		v0 = v1;
+		v1 = v;
+	}
+
+	ldtk_vertex *verts = &chunks->verts[vert];
+	verts[0] = (ldtk_vertex){ x0, y0, u0, v0 };
+	verts[1] = (ldtk_vertex){ x1, y0, u1, v0 };
+	verts[2] = (ldtk_vertex){ x1, y1, u1, v1 };
+	verts[3] = (ldtk_vertex){ x0, y1, u0, v1 };
+
+	u32 *indices = &chunks->indices[index];
+	indices[0] = vert;
+	indices[1] = vert + 1;
+	indices[2] = vert + 2;
+	indices[3] = vert;
+	indices[4] = vert + 2;
+	indices[5] = vert + 3;
+}
+
+static bool rect_overlap(ldtk_rect a, ldtk_rect b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+	       b.y < a.y + a.h;
+}
@@ -0,0 +1,477 @@
+/** ldtk_composite.c - draws the tiles of a layer, or every
+* layer of a level, into one rgba image on the cpu and writes
+* them out as png, for the image export modes of the project */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ldtk.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LDTK_X86
+#endif
+
+/** blends n pixels of src over dst */
+typedef void (*blend_fn)(u32 *dst, const u32 *src, u32 n);
+
+static ldtk_image *new_image(i32 w, i32 h);
+static void premultiply(ldtk_image *image);
+static void draw_layer(ldtk_lvl *lvl, ldtk_layer *layer, ldtk_image *dst);
+static void draw_tile(ldtk_image *dst, ldtk_image *src, ldtk_rect from,
+		      i32 x, i32 y, u8 f, u32 *row);
+static u32 blend_px(u32 dst, u32 src);
+static void blend_row_scalar(u32 *dst, const u32 *src, u32 n);
+#ifdef LDTK_X86
+static void blend_row_sse2(u32 *dst, const u32 *src, u32 n);
+static void blend_row_avx2(u32 *dst, const u32 *src, u32 n);
+#endif
+static void pick_blend_row(void);
+static void put_u32_be(u8 *out, u32 v);
+static u32 crc32_update(u32 crc, const u8 *data, usize len);
+static bool write_chunk(FILE *file, const char *type, const u8 *data,
+			u32 len);
+static bool write_lvl_pngs(ldtk_lvl *lvl, const char *name, char *dir);
+
+static blend_fn blend_row = blend_row_scalar;
+static pthread_once_t blend_once = PTHREAD_ONCE_INIT;
+static u32 crc_table[256];
+
+u32 ldtk_load_tileset_images(ldtk_image_loader loader, void *user)
+{
+	return ldtk_load_tileset_images_ctx(ldtk_get_ctx(), loader, user);
+}
+
+u32 ldtk_load_tileset_images_ctx(ldtk_ctx *ctx, ldtk_image_loader loader,
+				 void *user)
+{
+	u32 failed = 0;
+	for (u32 i = 0; i < ctx->tilesets->len; i++) {
+		ldtk_tileset *ts = bunlist_get(ctx->tilesets, i);
+		if (ts->image != NULL) {
+			ldtk_image_destroy(ts->image);
+			ts->image = NULL;
+		}
+		ldtk_image image = { NULL, 0, 0 };
+		if (!loader(ts, &image, user) || image.px == NULL ||
+		    image.w <= 0 || image.h <= 0) {
+			free(image.px);
+			failed++;
+			continue;
+		}
+		ts->image = malloc(sizeof(ldtk_image));
+		*ts->image = image;
+		premultiply(ts->image);
+	}
+	return failed;
+}
+
+ldtk_image *ldtk_composite_layer(ldtk_lvl *lvl, ldtk_layer *layer)
+{
+	if (layer->type == LDTK_LAYER_ENTITY)
+		return NULL;
+	pthread_once(&blend_once, pick_blend_row);
+	if (layer->composite != NULL) {
+		ldtk_image_destroy(layer->composite);
+	}
+	layer->composite = new_image(lvl->rect.w, lvl->rect.h);
+	draw_layer(lvl, layer, layer->composite);
+	return layer->composite;
+}
+
+ldtk_image *ldtk_composite_lvl(ldtk_lvl *lvl)
+{
+	pthread_once(&blend_once, pick_blend_row);
+	if (lvl->composite != NULL) {
+		ldtk_image_destroy(lvl->composite);
+	}
+	ldtk_image *image = new_image(lvl->rect.w, lvl->rect.h);
+	lvl->composite = image;
+	u32 bg = 0xff000000u | (u32)lvl->b << 16 | (u32)lvl->g << 8 | lvl->r;
+	for (i32 i = 0; i < image->w * image->h; i++) {
+		image->px[i] = bg;
+	}
+
+	// the first layer is the top one, so they're drawn back to front
+	for (u32 i = lvl->layers->len; i-- > 0;) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type == LDTK_LAYER_ENTITY)
+			continue;
+		ldtk_image *drawn = layer->composite;
+		if (drawn == NULL || drawn->w != image->w ||
+		    drawn->h != image->h) {
+			draw_layer(lvl, layer, image);
+			continue;
+		}
+		blend_row(image->px, drawn->px, image->w * image->h);
+	}
+	return image;
+}
+
+void ldtk_image_destroy(ldtk_image *image)
+{
+	free(image->px);
+	free(image);
+}
+
+bool ldtk_write_png(ldtk_image *image, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+	pthread_once(&blend_once, pick_blend_row);
+
+	u8 header[13];
+	put_u32_be(header, image->w);
+	put_u32_be(header + 4, image->h);
+	header[8] = 8; // bits per channel
+	header[9] = 6; // rgba
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+
+	// every row is a filter byte then the straight alpha pixels, stored in
+	// deflate blocks of up to 65535 bytes without compressing them
+	usize row_len = (usize)image->w * 4 + 1;
+	usize raw_len = row_len * image->h;
+	usize blocks = (raw_len + 65534) / 65535;
+	blocks = blocks > 0 ? blocks : 1;
+	usize zlib_len = 2 + blocks * 5 + raw_len + 4;
+	u8 *zlib = malloc(zlib_len);
+	u8 *raw = malloc(raw_len + 1);
+	for (i32 y = 0; y < image->h; y++) {
+		u8 *row = &raw[y * row_len];
+		row[0] = 0;
+		for (i32 x = 0; x < image->w; x++) {
+			u32 px = image->px[y * image->w + x];
+			u32 a = px >> 24;
+			u8 *out = &row[1 + x * 4];
+			for (u32 c = 0; c < 3; c++) {
+				u32 v = px >> (c * 8) & 0xff;
+				out[c] = a != 0 ? (v * 255 + a / 2) / a : 0;
+			}
+			out[3] = a;
+		}
+	}
+
+	u32 s1 = 1, s2 = 0;
+	for (usize i = 0; i < raw_len; i++) {
+		s1 = (s1 + raw[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	u8 *out = zlib;
+	*out++ = 0x78;
+	*out++ = 0x01;
+	for (usize done = 0; done < raw_len || out == zlib + 2;) {
+		u32 len = raw_len - done > 65535 ? 65535 : raw_len - done;
+		*out++ = done + len == raw_len;
+		out[0] = len & 0xff;
+		out[1] = len >> 8;
+		out[2] = ~len & 0xff;
+		out[3] = (~len >> 8) & 0xff;
+		out += 4;
+		memcpy(out, &raw[done], len);
+		out += len;
+		done += len;
+	}
+	put_u32_be(out, s2 << 16 | s1);
+	out += 4;
+	free(raw);
+
+	static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	bool ok = fwrite(signature, 1, 8, file) == 8 &&
+		  write_chunk(file, "IHDR", header, sizeof(header)) &&
+		  write_chunk(file, "IDAT", zlib, out - zlib) &&
+		  write_chunk(file, "IEND", NULL, 0);
+	free(zlib);
+	return fclose(file) == 0 && ok;
+}
+
+bool ldtk_bake_composites(char *dir)
+{
+	return ldtk_bake_composites_ctx(ldtk_get_ctx(), dir);
+}
+
+bool ldtk_bake_composites_ctx(ldtk_ctx *ctx, char *dir)
+{
+	bunlist *index = ldtk_get_lvl_index_ctx(ctx);
+	bool ok = true;
+	for (u32 i = 0; i < index->len; i++) {
+		ldtk_lvl_info *info = bunlist_get(index, i);
+		ldtk_lvl *lvl = ldtk_load_lvl_ctx(ctx, info->identifier);
+		if (lvl == NULL) {
+			ok = false;
+			continue;
+		}
+		ok = write_lvl_pngs(lvl, info->identifier, dir) && ok;
+		ldtk_destroy_lvl(lvl);
+	}
+	return ok;
+}
+
+/** \brief a transparent image, the pixels are zeroed */
+static ldtk_image *new_image(i32 w, i32 h)
+{
+	ldtk_image *image = malloc(sizeof(ldtk_image));
+	image->w = w > 0 ? w : 0;
+	image->h = h > 0 ? h : 0;
+	image->px = calloc((usize)image->w * image->h + 1, sizeof(u32));
+	return image;
+}
+
+static void premultiply(ldtk_image *image)
+{
+	for (i32 i = 0; i < image->w * image->h; i++) {
+		u32 px = image->px[i];
+		u32 a = px >> 24;
+		if (a == 255)
+			continue;
+		u32 out = a << 24;
+		for (u32 c = 0; c < 24; c += 8) {
+			u32 v = (px >> c & 0xff) * a + 128;
+			out |= ((v + (v >> 8)) >> 8) << c;
+		}
+		image->px[i] = out;
+	}
+}
+
+/** \brief draws the tiles of the layer over dst in their order,
+ * at their position in the level */
+static void draw_layer(ldtk_lvl *lvl, ldtk_layer *layer, ldtk_image *dst)
+{
+	ldtk_tileset *tileset = ldtk_layer_tileset(lvl, layer);
+	if (tileset == NULL || tileset->image == NULL)
+		return;
+	u32 *row = malloc(sizeof(u32) * (tileset->tile_size + 1));
+	u32 tiles = tileset->cw * tileset->ch;
+	u32 len = ldtk_layer_tile_count(layer);
+	ldtk_tile tile;
+	for (u32 i = 0; i < len; i++) {
+		ldtk_layer_tile(layer, i, &tile);
+		if (tile.t >= tiles)
+			continue;
+		draw_tile(dst, tileset->image, ldtk_tile_src(tileset, tile.t),
+			  tile.rect.x - lvl->rect.x, tile.rect.y - lvl->rect.y,
+			  tile.f, row);
+	}
+	free(row);
+}
+
+/** \brief blends the from rect of src at x, y of dst, clipped to both.
+ * a flipped row is gathered into row first, others are blended in place */
+static void draw_tile(ldtk_image *dst, ldtk_image *src, ldtk_rect from,
+		      i32 x, i32 y, u8 f, u32 *row)
+{
+	i32 x0 = x < 0 ? -x : 0;
+	i32 x1 = from.w < dst->w - x ? from.w : dst->w - x;
+	bool inside = from.x >= 0 && from.x + from.w <= src->w;
+	if (x0 >= x1)
+		return;
+	for (i32 ty = 0; ty < from.h; ty++) {
+		i32 dy = y + ty;
+		i32 sy = from.y + (f & 2 ? from.h - 1 - ty : ty);
+		if (dy < 0 || dy >= dst->h || sy < 0 || sy >= src->h)
+			continue;
+		u32 *out = &dst->px[dy * dst->w + x + x0];
+		u32 *in = &src->px[sy * src->w + from.x];
+		if (!(f & 1) && inside) {
+			blend_row(out, in + x0, x1 - x0);
+			continue;
+		}
+		u32 n = 0;
+		for (i32 tx = x0; tx < x1; tx++) {
+			i32 sx = f & 1 ? from.w - 1 - tx : tx;
+			bool in_src = from.x + sx >= 0 && from.x + sx < src->w;
+			row[n++] = in_src ? in[sx] : 0;
+		}
+		blend_row(out, row, n);
+	}
+}
+
+/** \brief src over dst with premultiplied alpha,
+ * dst * (255 - src alpha) / 255 rounded like the simd kernels */
+static u32 blend_px(u32 dst, u32 src)
+{
+	u32 inv = 255 - (src >> 24);
+	u32 out = 0;
+	for (u32 c = 0; c < 32; c += 8) {
+		u32 v = (dst >> c & 0xff) * inv + 128;
+		v = (v + (v >> 8)) >> 8;
+		out |= (v + (src >> c & 0xff)) << c;
+	}
+	return out;
+}
+
+static void blend_row_scalar(u32 *dst, const u32 *src, u32 n)
+{
+	for (u32 i = 0; i < n; i++) {
+		u32 a = src[i] >> 24;
+		if (a == 255) {
+			dst[i] = src[i];
+		} else if (a != 0) {
+			dst[i] = blend_px(dst[i], src[i]);
+		}
+	}
+}
+
+#ifdef LDTK_X86
+/** \brief blends 4 pixels at a time in 16 bit lanes,
+ * skipping the groups that are all opaque or all transparent */
+__attribute__((target("sse2"))) static void
+blend_row_sse2(u32 *dst, const u32 *src, u32 n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi32(0xff);
+	const __m128i round = _mm_set1_epi16(128);
+	u32 i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i s = _mm_loadu_si128((__m128i *)&src[i]);
+		__m128i a = _mm_srli_epi32(s, 24);
+		u32 opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(a, full));
+		if (opaque == 0xffff) {
+			_mm_storeu_si128((__m128i *)&dst[i], s);
+			continue;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, zero)) == 0xffff)
+			continue;
+		__m128i d = _mm_loadu_si128((__m128i *)&dst[i]);
+		// 255 - alpha spread over the 4 bytes of each pixel
+		__m128i inv = _mm_sub_epi32(full, a);
+		inv = _mm_or_si128(inv, _mm_slli_epi32(inv, 8));
+		inv = _mm_or_si128(inv, _mm_slli_epi32(inv, 16));
+
+		__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+					     _mm_unpacklo_epi8(inv, zero));
+		__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+					     _mm_unpackhi_epi8(inv, zero));
+		lo = _mm_add_epi16(lo, round);
+		hi = _mm_add_epi16(hi, round);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+		__m128i out = _mm_add_epi8(_mm_packus_epi16(lo, hi), s);
+		_mm_storeu_si128((__m128i *)&dst[i], out);
+	}
+	blend_row_scalar(&dst[i], &src[i], n - i);
+}
+
+/** \brief same as blend_row_sse2 but with 8 pixels at a time */
+__attribute__((target("avx2"))) static void
+blend_row_avx2(u32 *dst, const u32 *src, u32 n)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i full = _mm256_set1_epi32(0xff);
+	const __m256i round = _mm256_set1_epi16(128);
+	u32 i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i s = _mm256_loadu_si256((__m256i *)&src[i]);
+		__m256i a = _mm256_srli_epi32(s, 24);
+		u32 opaque = _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, full));
+		if (opaque == 0xffffffff) {
+			_mm256_storeu_si256((__m256i *)&dst[i], s);
+			continue;
+		}
+		if ((u32)_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, zero)) ==
+		    0xffffffff)
+			continue;
+		__m256i d = _mm256_loadu_si256((__m256i *)&dst[i]);
+		__m256i inv = _mm256_sub_epi32(full, a);
+		inv = _mm256_or_si256(inv, _mm256_slli_epi32(inv, 8));
+		inv = _mm256_or_si256(inv, _mm256_slli_epi32(inv, 16));
+
+		// unpack and pack work within each 128 bit half, so the order holds
+		__m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+						_mm256_unpacklo_epi8(inv, zero));
+		__m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+						_mm256_unpackhi_epi8(inv, zero));
+		lo = _mm256_add_epi16(lo, round);
+		hi = _mm256_add_epi16(hi, round);
+		lo = _mm256_srli_epi16(
+			_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+		hi = _mm256_srli_epi16(
+			_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+		__m256i out = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), s);
+		_mm256_storeu_si256((__m256i *)&dst[i], out);
+	}
+	blend_row_scalar(&dst[i], &src[i], n - i);
+}
+#endif
+
+/** \brief picks the fastest blend kernel the cpu supports,
+ * and fills the crc table of the png writer */
+static void pick_blend_row(void)
+{
+	for (u32 i = 0; i < 256; i++) {
+		u32 c = i;
+		for (u32 k = 0; k < 8; k++) {
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		}
+		crc_table[i] = c;
+	}
+#ifdef LDTK_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		blend_row = blend_row_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		blend_row = blend_row_sse2;
+	}
+#endif
+}
+
+static void put_u32_be(u8 *out, u32 v)
+{
+	out[0] = v >> 24;
+	out[1] = v >> 16;
+	out[2] = v >> 8;
+	out[3] = v;
+}
+
+static u32 crc32_update(u32 crc, const u8 *data, usize len)
+{
+	for (usize i = 0; i < len; i++) {
+		crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+/** \brief writes a png chunk, its length, type, data and crc */
+static bool write_chunk(FILE *file, const char *type, const u8 *data,
+			u32 len)
+{
+	u8 buf[4];
+	put_u32_be(buf, len);
+	u32 crc = crc32_update(0xffffffffu, (const u8 *)type, 4);
+	crc = crc32_update(crc, data, len);
+	bool ok = fwrite(buf, 1, 4, file) == 4 && fwrite(type, 1, 4, file) == 4;
+	if (len > 0) {
+		ok = ok && fwrite(data, 1, len, file) == len;
+	}
+	put_u32_be(buf, ~crc);
+	return ok && fwrite(buf, 1, 4, file) == 4;
+}
+
+/** \brief writes the composites the level got at load,
+ * or draws and writes the level one if it got none */
+static bool write_lvl_pngs(ldtk_lvl *lvl, const char *name, char *dir)
+{
+	bool ok = true;
+	bool wrote = false;
+	char path[1024];
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->composite == NULL)
+			continue;
+		snprintf(path, sizeof(path), "%s%s__%s.png", dir, name,
+			 layer->identifier);
+		ok = ldtk_write_png(layer->composite, path) && ok;
+		wrote = true;
+	}
+	if (lvl->composite == NULL && !wrote) {
+		ldtk_composite_lvl(lvl);
+	}
+	if (lvl->composite != NULL) {
+		snprintf(path, sizeof(path), "%s%s.png", dir, name);
+		ok = ldtk_write_png(lvl->composite, path) && ok;
+	}
+	return ok;
+}
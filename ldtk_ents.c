@@ -0,0 +1,117 @@
+/** ldtk_ents.c - groups the entities of a level by type,
+* so every entity of one type is a contiguous slice */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ldtk.h"
+
+static bool same_type(const char *a, const char *b);
+static u32 find_type(ldtk_ent_index *index, const char *identifier);
+
+ldtk_ent_index *ldtk_ent_index_build(ldtk_lvl *lvl)
+{
+	u32 ent_count = 0;
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type == LDTK_LAYER_ENTITY)
+			ent_count += layer->content->len;
+	}
+
+	// one block, the types can't outnumber the entities
+	ldtk_ent_index *index = malloc(sizeof(ldtk_ent_index) +
+				       ent_count * sizeof(ldtk_ent *) +
+				       ent_count * sizeof(ldtk_ent_type));
+	index->ents = (ldtk_ent **)(index + 1);
+	index->types = (ldtk_ent_type *)(index->ents + ent_count);
+	index->ent_count = ent_count;
+	index->type_count = 0;
+
+	// counting sort by type: count, turn the counts into offsets, then fill
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type != LDTK_LAYER_ENTITY)
+			continue;
+		for (u32 j = 0; j < layer->content->len; j++) {
+			ldtk_ent *ent = bunlist_get(layer->content, j);
+			u32 t = find_type(index, ent->identifier);
+			if (t == index->type_count) {
+				index->types[t] = (ldtk_ent_type){
+					.identifier = ent->identifier,
+					.start = 0,
+					.count = 0
+				};
+				index->type_count++;
+			}
+			index->types[t].count++;
+		}
+	}
+	u32 start = 0;
+	for (u32 t = 0; t < index->type_count; t++) {
+		index->types[t].start = start;
+		start += index->types[t].count;
+		index->types[t].count = 0;
+	}
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type != LDTK_LAYER_ENTITY)
+			continue;
+		for (u32 j = 0; j < layer->content->len; j++) {
+			ldtk_ent *ent = bunlist_get(layer->content, j);
+			ldtk_ent_type *type =
+				&index->types[find_type(index, ent->identifier)];
+			index->ents[type->start + type->count++] = ent;
+		}
+	}
+	return index;
+}
+
+void ldtk_ent_index_destroy(ldtk_ent_index *index)
+{
+	free(index);
+}
+
+ldtk_ent **ldtk_ents_of_type(ldtk_lvl *lvl, const char *identifier,
+			     u32 *count)
+{
+	*count = 0;
+	ldtk_ent_index *index = lvl->ent_index;
+	if (index == NULL || identifier == NULL)
+		return NULL;
+	u32 t = find_type(index, identifier);
+	if (t == index->type_count)
+		return NULL;
+	*count = index->types[t].count;
+	return &index->ents[index->types[t].start];
+}
+
+bool ldtk_ent_has_tag(ldtk_ent *ent, const char *tag)
+{
+	if (ent->tags == NULL)
+		return false;
+	for (u32 i = 0; i < ent->tags->len; i++) {
+		char **tag_i = bunlist_get(ent->tags, i);
+		if (strcmp(*tag_i, tag) == 0)
+			return true;
+	}
+	return false;
+}
+
+/** \brief interned identifiers match by pointer, the rest by content */
+static bool same_type(const char *a, const char *b)
+{
+	if (a == b)
+		return true;
+	return a != NULL && b != NULL && strcmp(a, b) == 0;
+}
+
+/** \brief index of the type with that identifier, or type_count. 
+ * a level has a handful of types, so a linear scan is enough */
+static u32 find_type(ldtk_ent_index *index, const char *identifier)
+{
+	u32 t = 0;
+	while (t < index->type_count &&
+	       !same_type(index->types[t].identifier, identifier)) {
+		t++;
+	}
+	return t;
+}
@@ -0,0 +1,500 @@
+/** ldtk_fields.c - custom fields decoded at load time
+* into one flat block with a hash table, so they can be
+* read every frame without touching json or allocating */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ldtk_private.h"
+
+#define FIELD_ALIGN 8 // floats are f64
+
+static LDTK_FIELD_TYPE field_type(const char *type, bool *array);
+static usize field_isize(LDTK_FIELD_TYPE type);
+static bool field_is_str(LDTK_FIELD_TYPE type);
+static u32 put(bunlist *block, const void *data, usize size);
+static u32 put_str(bunlist *block, const char *str);
+static void put_value(bunlist *block, u32 at, LDTK_FIELD_TYPE type,
+		      json_object *value);
+static const ldtk_field *find_typed(const ldtk_fields *fields,
+				    const char *name, LDTK_FIELD_TYPE type);
+static const u8 *field_values(const ldtk_fields *fields,
+			      const ldtk_field *field);
+static bool valid_str(const u8 *base, usize size, u32 off);
+
+ldtk_fields *ldtk_fields_build(json_object *field_instances, bunarena *arena)
+{
+	if (field_instances == NULL)
+		return NULL;
+	u32 len = json_object_array_length(field_instances);
+	if (len == 0)
+		return NULL;
+
+	u32 slots = 4;
+	while (slots < len * 2) {
+		slots *= 2;
+	}
+	usize table = sizeof(ldtk_fields) + len * sizeof(ldtk_field) +
+		      slots * sizeof(u32);
+
+	// the table is written last, the block can still move until then
+	bunlist *block = bunlist_create(1, table + 256, NULL);
+	put(block, NULL, table);
+	ldtk_field *fields = calloc(len, sizeof(ldtk_field));
+
+	for (u32 i = 0; i < len; i++) {
+		json_object *field_i =
+			json_object_array_get_idx(field_instances, i);
+		const char *name = json_object_get_string(
+			json_object_object_get(field_i, "__identifier"));
+		const char *type = json_object_get_string(
+			json_object_object_get(field_i, "__type"));
+		json_object *value = json_object_object_get(field_i, "__value");
+
+		ldtk_field *field = &fields[i];
+		name = name != NULL ? name : "";
+		field->hash = ldtk_hash_str(name);
+		field->name = put_str(block, name);
+		field->type = field_type(type, &field->array);
+
+		enum json_type vtype = json_object_get_type(value);
+		if (field->type == LDTK_FIELD_UNKNOWN || vtype == json_type_null)
+			continue;
+		if (field->array && vtype != json_type_array)
+			continue;
+
+		// strings are put after the values, which hold their offsets
+		field->len = field->array ? json_object_array_length(value) : 1;
+		usize isize = field_isize(field->type);
+		field->data = put(block, NULL, field->len * isize);
+		for (u32 j = 0; j < field->len; j++) {
+			json_object *value_j =
+				field->array ? json_object_array_get_idx(value, j) :
+					       value;
+			put_value(block, field->data + j * isize, field->type,
+				  value_j);
+		}
+	}
+
+	u8 *items = block->items;
+	ldtk_fields hdr = { .size = block->len, .len = len, .mask = slots - 1 };
+	memcpy(items, &hdr, sizeof(hdr));
+	memcpy(items + sizeof(hdr), fields, len * sizeof(ldtk_field));
+	u32 *slot = (u32 *)(items + sizeof(hdr) + len * sizeof(ldtk_field));
+	for (u32 i = 0; i < len; i++) {
+		u32 s = fields[i].hash & hdr.mask;
+		while (slot[s] != 0) {
+			s = (s + 1) & hdr.mask;
+		}
+		slot[s] = i + 1;
+	}
+
+	ldtk_fields *out = arena != NULL ? bunarena_alloc(arena, block->len) :
+					   malloc(block->len);
+	memcpy(out, block->items, block->len);
+	bunlist_destroy(block);
+	free(fields);
+	return out;
+}
+
+bool ldtk_fields_valid(const ldtk_fields *fields, usize size)
+{
+	if (size < sizeof(ldtk_fields) || fields->size > size ||
+	    fields->size < sizeof(ldtk_fields))
+		return false;
+	size = fields->size;
+
+	// the table must have a free slot, or a lookup would never end
+	u64 slots = (u64)fields->mask + 1;
+	if ((slots & fields->mask) != 0 || slots <= fields->len)
+		return false;
+	u64 table = sizeof(ldtk_fields) + (u64)fields->len * sizeof(ldtk_field) +
+		    slots * sizeof(u32);
+	if (table > size)
+		return false;
+
+	const u8 *base = (const u8 *)fields;
+	const ldtk_field *field = (const ldtk_field *)(fields + 1);
+	const u32 *slot = (const u32 *)(field + fields->len);
+	u32 used = 0;
+	for (u64 s = 0; s < slots; s++) {
+		if (slot[s] > fields->len)
+			return false;
+		used += slot[s] != 0;
+	}
+	if (used != fields->len)
+		return false;
+
+	for (u32 i = 0; i < fields->len; i++) {
+		const ldtk_field *f = &field[i];
+		if (!valid_str(base, size, f->name) ||
+		    f->type > LDTK_FIELD_UNKNOWN)
+			return false;
+		if (f->len == 0)
+			continue;
+		usize isize = field_isize(f->type);
+		if (isize == 0 || f->data % FIELD_ALIGN != 0 || f->data > size ||
+		    f->len > (size - f->data) / isize)
+			return false;
+		if (!field_is_str(f->type))
+			continue;
+		for (u32 j = 0; j < f->len; j++) {
+			u32 off;
+			memcpy(&off, base + f->data + j * isize, sizeof(off));
+			if (off != 0 && !valid_str(base, size, off))
+				return false;
+		}
+	}
+	return true;
+}
+
+const ldtk_field *ldtk_field_get(const ldtk_fields *fields, const char *name)
+{
+	if (fields == NULL)
+		return NULL;
+	const u8 *base = (const u8 *)fields;
+	const ldtk_field *field = (const ldtk_field *)(fields + 1);
+	const u32 *slot = (const u32 *)(field + fields->len);
+	u32 hash = ldtk_hash_str(name);
+	for (u32 s = hash & fields->mask; slot[s] != 0;
+	     s = (s + 1) & fields->mask) {
+		const ldtk_field *f = &field[slot[s] - 1];
+		if (f->hash == hash &&
+		    strcmp((const char *)base + f->name, name) == 0)
+			return f;
+	}
+	return NULL;
+}
+
+i32 ldtk_field_int(const ldtk_fields *fields, const char *name, i32 def)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_INT);
+	if (field == NULL || field->array)
+		return def;
+	i32 value;
+	memcpy(&value, field_values(fields, field), sizeof(value));
+	return value;
+}
+
+f64 ldtk_field_float(const ldtk_fields *fields, const char *name, f64 def)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_FLOAT);
+	if (field != NULL && !field->array) {
+		f64 value;
+		memcpy(&value, field_values(fields, field), sizeof(value));
+		return value;
+	}
+	field = find_typed(fields, name, LDTK_FIELD_INT);
+	if (field == NULL || field->array)
+		return def;
+	i32 value;
+	memcpy(&value, field_values(fields, field), sizeof(value));
+	return value;
+}
+
+bool ldtk_field_bool(const ldtk_fields *fields, const char *name, bool def)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_BOOL);
+	if (field == NULL || field->array)
+		return def;
+	return *field_values(fields, field) != 0;
+}
+
+u32 ldtk_field_color(const ldtk_fields *fields, const char *name, u32 def)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_COLOR);
+	if (field == NULL || field->array)
+		return def;
+	u32 value;
+	memcpy(&value, field_values(fields, field), sizeof(value));
+	return value;
+}
+
+bool ldtk_field_point(const ldtk_fields *fields, const char *name,
+		      ldtk_point *pt)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_POINT);
+	if (field == NULL || field->array)
+		return false;
+	memcpy(pt, field_values(fields, field), sizeof(ldtk_point));
+	return true;
+}
+
+bool ldtk_field_tile(const ldtk_fields *fields, const char *name,
+		     ldtk_tile_ref *tile)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_TILE);
+	if (field == NULL || field->array)
+		return false;
+	memcpy(tile, field_values(fields, field), sizeof(ldtk_tile_ref));
+	return true;
+}
+
+const char *ldtk_field_str(const ldtk_fields *fields, const char *name)
+{
+	const ldtk_field *field = ldtk_field_get(fields, name);
+	if (field == NULL || field->array)
+		return NULL;
+	return ldtk_field_str_at(fields, name, 0);
+}
+
+const char *ldtk_field_enum(const ldtk_fields *fields, const char *name)
+{
+	const ldtk_field *field = find_typed(fields, name, LDTK_FIELD_ENUM);
+	if (field == NULL || field->array)
+		return NULL;
+	return ldtk_field_str_at(fields, name, 0);
+}
+
+const void *ldtk_field_array(const ldtk_fields *fields, const char *name,
+			     LDTK_FIELD_TYPE type, u32 *len)
+{
+	*len = 0;
+	const ldtk_field *field = find_typed(fields, name, type);
+	if (field == NULL || field_is_str(type))
+		return NULL;
+	*len = field->len;
+	return field_values(fields, field);
+}
+
+const char *ldtk_field_str_at(const ldtk_fields *fields, const char *name,
+			      u32 i)
+{
+	const ldtk_field *field = ldtk_field_get(fields, name);
+	if (field == NULL || !field_is_str(field->type) || i >= field->len)
+		return NULL;
+	u32 off;
+	memcpy(&off, field_values(fields, field) + i * sizeof(u32),
+	       sizeof(off));
+	return off == 0 ? NULL : (const char *)fields + off;
+}
+
+void *ldtk_field_dup(const ldtk_fields *fields, const char *name)
+{
+	const ldtk_field *field = ldtk_field_get(fields, name);
+	if (field == NULL || field->array || field->len == 0)
+		return NULL;
+	const u8 *value = field_values(fields, field);
+	if (field_is_str(field->type)) {
+		const char *str = ldtk_field_str_at(fields, name, 0);
+		return str != NULL ? strdup(str) : NULL;
+	}
+
+	switch (field->type) {
+	case LDTK_FIELD_INT: {
+		i32 *var = malloc(sizeof(i32));
+		memcpy(var, value, sizeof(i32));
+		return var;
+	}
+	case LDTK_FIELD_FLOAT: {
+		f64 *var = malloc(sizeof(f64));
+		memcpy(var, value, sizeof(f64));
+		return var;
+	}
+	case LDTK_FIELD_BOOL: {
+		bool *var = malloc(sizeof(bool));
+		memcpy(var, value, sizeof(bool));
+		return var;
+	}
+	case LDTK_FIELD_COLOR: {
+		u32 color;
+		memcpy(&color, value, sizeof(color));
+		char *var = malloc(8);
+		snprintf(var, 8, "#%06X", color & 0xFFFFFF);
+		return var;
+	}
+	default:
+		return NULL;
+	}
+}
+
+/** \brief maps the ldtk __type of a field to its LDTK_FIELD_TYPE
+ * \param array set to true if the type is an Array<...> */
+static LDTK_FIELD_TYPE field_type(const char *type, bool *array)
+{
+	*array = false;
+	if (type == NULL)
+		return LDTK_FIELD_UNKNOWN;
+	char base[128];
+	if (strncmp(type, "Array<", 6) == 0) {
+		*array = true;
+		type += 6;
+	}
+	usize len = strlen(type);
+	if (*array && len > 0) {
+		len--; // the closing >
+	}
+	if (len >= sizeof(base))
+		return LDTK_FIELD_UNKNOWN;
+	memcpy(base, type, len);
+	base[len] = '\0';
+
+	if (strcmp(base, "Int") == 0)
+		return LDTK_FIELD_INT;
+	if (strcmp(base, "Float") == 0)
+		return LDTK_FIELD_FLOAT;
+	if (strcmp(base, "Bool") == 0)
+		return LDTK_FIELD_BOOL;
+	if (strcmp(base, "String") == 0 || strcmp(base, "Multilines") == 0)
+		return LDTK_FIELD_STRING;
+	if (strcmp(base, "Color") == 0)
+		return LDTK_FIELD_COLOR;
+	if (strcmp(base, "Point") == 0)
+		return LDTK_FIELD_POINT;
+	if (strcmp(base, "FilePath") == 0)
+		return LDTK_FIELD_FILE;
+	if (strcmp(base, "EntityRef") == 0)
+		return LDTK_FIELD_ENTITY_REF;
+	if (strcmp(base, "Tile") == 0)
+		return LDTK_FIELD_TILE;
+	// LocalEnum.Name or ExternEnum.Name
+	if (strncmp(base, "LocalEnum.", 10) == 0 ||
+	    strncmp(base, "ExternEnum.", 11) == 0)
+		return LDTK_FIELD_ENUM;
+	return LDTK_FIELD_UNKNOWN;
+}
+
+/** \brief size of one value of type in the block, 0 if it has no values */
+static usize field_isize(LDTK_FIELD_TYPE type)
+{
+	switch (type) {
+	case LDTK_FIELD_BOOL:
+		return sizeof(bool);
+	case LDTK_FIELD_FLOAT:
+		return sizeof(f64);
+	case LDTK_FIELD_POINT:
+		return sizeof(ldtk_point);
+	case LDTK_FIELD_TILE:
+		return sizeof(ldtk_tile_ref);
+	case LDTK_FIELD_UNKNOWN:
+		return 0;
+	default:
+		return sizeof(u32);
+	}
+}
+
+static bool field_is_str(LDTK_FIELD_TYPE type)
+{
+	return type == LDTK_FIELD_STRING || type == LDTK_FIELD_ENUM ||
+	       type == LDTK_FIELD_FILE || type == LDTK_FIELD_ENTITY_REF;
+}
+
+/** \brief appends size bytes of data, or zeros if data is NULL,
+ * aligned to FIELD_ALIGN
+ * \return the offset of the data in the block */
+static u32 put(bunlist *block, const void *data, usize size)
+{
+	usize at = (block->len + FIELD_ALIGN - 1) & ~(usize)(FIELD_ALIGN - 1);
+	usize cap = block->cap;
+	while (cap < at + size) {
+		cap *= 2;
+	}
+	bunlist_reserve(block, cap);
+
+	u8 *items = block->items;
+	memset(items + block->len, 0, at - block->len);
+	if (data != NULL) {
+		memcpy(items + at, data, size);
+	} else {
+		memset(items + at, 0, size);
+	}
+	block->len = at + size;
+	return at;
+}
+
+static u32 put_str(bunlist *block, const char *str)
+{
+	return put(block, str, strlen(str) + 1);
+}
+
+/** \brief writes one value at offset at, null values are left at 0 */
+static void put_value(bunlist *block, u32 at, LDTK_FIELD_TYPE type,
+		      json_object *value)
+{
+	if (json_object_get_type(value) == json_type_null)
+		return;
+
+	switch (type) {
+	case LDTK_FIELD_INT: {
+		i32 v = json_object_get_int(value);
+		memcpy((u8 *)block->items + at, &v, sizeof(v));
+		break;
+	}
+	case LDTK_FIELD_FLOAT: {
+		f64 v = json_object_get_double(value);
+		memcpy((u8 *)block->items + at, &v, sizeof(v));
+		break;
+	}
+	case LDTK_FIELD_BOOL: {
+		bool v = json_object_get_boolean(value);
+		memcpy((u8 *)block->items + at, &v, sizeof(v));
+		break;
+	}
+	case LDTK_FIELD_COLOR: {
+		// colors are "#rrggbb"
+		u32 v = 0;
+		const char *hex = json_object_get_string(value);
+		if (hex != NULL && hex[0] == '#') {
+			sscanf(&hex[1], "%06x", &v);
+		}
+		memcpy((u8 *)block->items + at, &v, sizeof(v));
+		break;
+	}
+	case LDTK_FIELD_POINT: {
+		ldtk_point v = {
+			json_object_get_int(json_object_object_get(value, "cx")),
+			json_object_get_int(json_object_object_get(value, "cy"))
+		};
+		memcpy((u8 *)block->items + at, &v, sizeof(v));
+		break;
+	}
+	case LDTK_FIELD_TILE: {
+		ldtk_tile_ref v = {
+			json_object_get_int(
+				json_object_object_get(value, "tilesetUid")),
+			{ json_object_get_int(json_object_object_get(value, "x")),
+			  json_object_get_int(json_object_object_get(value, "y")),
+			  json_object_get_int(json_object_object_get(value, "w")),
+			  json_object_get_int(
+				  json_object_object_get(value, "h")) }
+		};
+		memcpy((u8 *)block->items + at, &v, sizeof(v));
+		break;
+	}
+	default: {
+		// entity refs are objects, the iid is what identifies them
+		const char *str =
+			type == LDTK_FIELD_ENTITY_REF ?
+				json_object_get_string(json_object_object_get(
+					value, "entityIid")) :
+				json_object_get_string(value);
+		if (str == NULL)
+			break;
+		u32 off = put_str(block, str);
+		memcpy((u8 *)block->items + at, &off, sizeof(off));
+		break;
+	}
+	}
+}
+
+/** \brief the field with that name if it has type and a value */
+static const ldtk_field *find_typed(const ldtk_fields *fields,
+				    const char *name, LDTK_FIELD_TYPE type)
+{
+	const ldtk_field *field = ldtk_field_get(fields, name);
+	if (field == NULL || field->type != type || field->len == 0)
+		return NULL;
+	return field;
+}
+
+static const u8 *field_values(const ldtk_fields *fields,
+			      const ldtk_field *field)
+{
+	return (const u8 *)fields + field->data;
+}
+
+/** \brief true if off is a null terminated string inside the block */
+static bool valid_str(const u8 *base, usize size, u32 off)
+{
+	return off < size && memchr(base + off, '\0', size - off) != NULL;
+}
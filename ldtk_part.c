@@ -0,0 +1,318 @@
+/** ldtk_part.c - uniform grid spatial partition 
+* over the walls and entities of a level, 
+* built when LDTK_LEVEL_GRID_PARTITION is enabled */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ldtk_private.h"
+
+static void cell_range(ldtk_part *part, ldtk_rect rect, i32 *x0, i32 *y0,
+		       i32 *x1, i32 *y1);
+static i32 cell_clamp(i32 v, i32 min, i32 max);
+static bool rect_overlap(ldtk_rect a, ldtk_rect b);
+static bool owns_overlap(ldtk_part *part, ldtk_rect obj, ldtk_rect area,
+			 i32 cx, i32 cy);
+static void gather_ents(ldtk_lvl *lvl, bunlist *ents);
+static void cell_push(ldtk_part *part, u32 cell, u32 wall);
+static void pack_walls(ldtk_part *part, u32 need);
+
+ldtk_part *ldtk_part_build(ldtk_lvl *lvl, u32 cell_size)
+{
+	ldtk_part *part = malloc(sizeof(ldtk_part));
+	part->rect = lvl->rect;
+	part->cell_size = cell_size > 0 ? cell_size : 1;
+	part->cw = (lvl->rect.w + part->cell_size - 1) / part->cell_size;
+	part->ch = (lvl->rect.h + part->cell_size - 1) / part->cell_size;
+	part->cw = part->cw > 0 ? part->cw : 1;
+	part->ch = part->ch > 0 ? part->ch : 1;
+	u32 cells = part->cw * part->ch;
+
+	bunlist *ents = bunlist_create(sizeof(ldtk_ent *), 16, NULL);
+	gather_ents(lvl, ents);
+
+	// counting sort: count the objects of each cell, turn the counts
+	// into offsets and then drop every object into its cells
+	part->wall_start = calloc(cells + 1, sizeof(u32));
+	part->ent_start = calloc(cells + 1, sizeof(u32));
+	i32 x0, y0, x1, y1;
+	for (u32 i = 0; i < lvl->walls->len; i++) {
+		ldtk_rect rect = ldtk_wall_px(lvl, bunlist_get(lvl->walls, i));
+		cell_range(part, rect, &x0, &y0, &x1, &y1);
+		for (i32 y = y0; y <= y1; y++) {
+			for (i32 x = x0; x <= x1; x++) {
+				part->wall_start[y * part->cw + x + 1]++;
+			}
+		}
+	}
+	for (u32 i = 0; i < ents->len; i++) {
+		ldtk_ent **ent = bunlist_get(ents, i);
+		cell_range(part, (*ent)->rect, &x0, &y0, &x1, &y1);
+		for (i32 y = y0; y <= y1; y++) {
+			for (i32 x = x0; x <= x1; x++) {
+				part->ent_start[y * part->cw + x + 1]++;
+			}
+		}
+	}
+	for (u32 i = 0; i < cells; i++) {
+		part->wall_start[i + 1] += part->wall_start[i];
+		part->ent_start[i + 1] += part->ent_start[i];
+	}
+
+	part->wall_idx = malloc(sizeof(u32) * (part->wall_start[cells] + 1));
+	part->ents = malloc(sizeof(ldtk_ent *) * (part->ent_start[cells] + 1));
+	u32 *fill = malloc(sizeof(u32) * cells);
+
+	memcpy(fill, part->wall_start, sizeof(u32) * cells);
+	for (u32 i = 0; i < lvl->walls->len; i++) {
+		ldtk_rect rect = ldtk_wall_px(lvl, bunlist_get(lvl->walls, i));
+		cell_range(part, rect, &x0, &y0, &x1, &y1);
+		for (i32 y = y0; y <= y1; y++) {
+			for (i32 x = x0; x <= x1; x++) {
+				part->wall_idx[fill[y * part->cw + x]++] = i;
+			}
+		}
+	}
+	memcpy(fill, part->ent_start, sizeof(u32) * cells);
+	for (u32 i = 0; i < ents->len; i++) {
+		ldtk_ent **ent = bunlist_get(ents, i);
+		cell_range(part, (*ent)->rect, &x0, &y0, &x1, &y1);
+		for (i32 y = y0; y <= y1; y++) {
+			for (i32 x = x0; x <= x1; x++) {
+				part->ents[fill[y * part->cw + x]++] = *ent;
+			}
+		}
+	}
+
+	free(fill);
+	bunlist_destroy(ents);
+
+	// every cell starts with no room to spare, see cell_push
+	part->wall_end = malloc(sizeof(u32) * cells);
+	part->wall_room = malloc(sizeof(u32) * cells);
+	memcpy(part->wall_end, part->wall_start + 1, sizeof(u32) * cells);
+	memcpy(part->wall_room, part->wall_start + 1, sizeof(u32) * cells);
+	part->wall_len = part->wall_start[cells];
+	part->wall_cap = part->wall_len + 1;
+	return part;
+}
+
+void ldtk_part_destroy(ldtk_part *part)
+{
+	free(part->wall_start);
+	free(part->wall_end);
+	free(part->wall_room);
+	free(part->wall_idx);
+	free(part->ent_start);
+	free(part->ents);
+	free(part);
+}
+
+u32 ldtk_query_walls(ldtk_lvl *lvl, ldtk_rect area, bunlist *out)
+{
+	ldtk_part *part = lvl->part;
+	if (part == NULL)
+		return 0;
+
+	u32 found = 0;
+	i32 x0, y0, x1, y1;
+	cell_range(part, area, &x0, &y0, &x1, &y1);
+	for (i32 y = y0; y <= y1; y++) {
+		for (i32 x = x0; x <= x1; x++) {
+			u32 cell = y * part->cw + x;
+			for (u32 i = part->wall_start[cell];
+			     i < part->wall_end[cell]; i++) {
+				ldtk_wall *wall =
+					bunlist_get(lvl->walls, part->wall_idx[i]);
+				ldtk_rect rect = ldtk_wall_px(lvl, wall);
+				if (owns_overlap(part, rect, area, x, y)) {
+					bunlist_append(out, &wall);
+					found++;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+u32 ldtk_query_ents(ldtk_lvl *lvl, ldtk_rect area, bunlist *out)
+{
+	ldtk_part *part = lvl->part;
+	if (part == NULL)
+		return 0;
+
+	u32 found = 0;
+	i32 x0, y0, x1, y1;
+	cell_range(part, area, &x0, &y0, &x1, &y1);
+	for (i32 y = y0; y <= y1; y++) {
+		for (i32 x = x0; x <= x1; x++) {
+			u32 cell = y * part->cw + x;
+			for (u32 i = part->ent_start[cell];
+			     i < part->ent_start[cell + 1]; i++) {
+				ldtk_ent *ent = part->ents[i];
+				if (owns_overlap(part, ent->rect, area, x, y)) {
+					bunlist_append(out, &ent);
+					found++;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+u32 ldtk_query_walls_pt(ldtk_lvl *lvl, i32 x, i32 y, bunlist *out)
+{
+	ldtk_rect area = { x, y, 1, 1 };
+	return ldtk_query_walls(lvl, area, out);
+}
+
+u32 ldtk_query_ents_pt(ldtk_lvl *lvl, i32 x, i32 y, bunlist *out)
+{
+	ldtk_rect area = { x, y, 1, 1 };
+	return ldtk_query_ents(lvl, area, out);
+}
+
+void ldtk_part_remove_wall(ldtk_lvl *lvl, u32 i)
+{
+	ldtk_part *part = lvl->part;
+	ldtk_rect rect = ldtk_wall_px(lvl, bunlist_get(lvl->walls, i));
+	i32 x0, y0, x1, y1;
+	cell_range(part, rect, &x0, &y0, &x1, &y1);
+	for (i32 y = y0; y <= y1; y++) {
+		for (i32 x = x0; x <= x1; x++) {
+			u32 cell = y * part->cw + x;
+			u32 *end = &part->wall_end[cell];
+			for (u32 j = part->wall_start[cell]; j < *end; j++) {
+				if (part->wall_idx[j] != i)
+					continue;
+				part->wall_idx[j] = part->wall_idx[--*end];
+				break;
+			}
+		}
+	}
+}
+
+void ldtk_part_add_wall(ldtk_lvl *lvl, u32 i)
+{
+	ldtk_part *part = lvl->part;
+	ldtk_rect rect = ldtk_wall_px(lvl, bunlist_get(lvl->walls, i));
+	i32 x0, y0, x1, y1;
+	cell_range(part, rect, &x0, &y0, &x1, &y1);
+	for (i32 y = y0; y <= y1; y++) {
+		for (i32 x = x0; x <= x1; x++) {
+			cell_push(part, y * part->cw + x, i);
+		}
+	}
+}
+
+/** \brief adds wall to the cell, in its room if it has some left, or
+ * after moving the cell to the end of wall_idx with twice the room */
+static void cell_push(ldtk_part *part, u32 cell, u32 wall)
+{
+	if (part->wall_end[cell] == part->wall_room[cell]) {
+		u32 len = part->wall_end[cell] - part->wall_start[cell];
+		u32 room = len > 2 ? len * 2 : 4;
+		if (part->wall_len + room > part->wall_cap) {
+			pack_walls(part, part->wall_len + room);
+		}
+		memcpy(&part->wall_idx[part->wall_len],
+		       &part->wall_idx[part->wall_start[cell]],
+		       sizeof(u32) * len);
+		part->wall_start[cell] = part->wall_len;
+		part->wall_end[cell] = part->wall_len + len;
+		part->wall_room[cell] = part->wall_len + room;
+		part->wall_len += room;
+	}
+	part->wall_idx[part->wall_end[cell]++] = wall;
+}
+
+/** \brief moves every cell to the front of a new wall_idx with no room
+ * to spare, dropping the holes left by the cells that moved. wall_idx
+ * grows to twice what it needs, so this runs once in many pushes
+ * \param need the size wall_idx must at least have */
+static void pack_walls(ldtk_part *part, u32 need)
+{
+	u32 cells = part->cw * part->ch;
+	u32 len = 0;
+	for (u32 i = 0; i < cells; i++) {
+		len += part->wall_end[i] - part->wall_start[i];
+	}
+	u32 cap = (need - part->wall_len + len) * 2;
+	u32 *idx = malloc(sizeof(u32) * cap);
+	u32 at = 0;
+	for (u32 i = 0; i < cells; i++) {
+		u32 n = part->wall_end[i] - part->wall_start[i];
+		memcpy(&idx[at], &part->wall_idx[part->wall_start[i]],
+		       sizeof(u32) * n);
+		part->wall_start[i] = at;
+		part->wall_end[i] = at + n;
+		part->wall_room[i] = at + n;
+		at += n;
+	}
+	free(part->wall_idx);
+	part->wall_idx = idx;
+	part->wall_len = at;
+	part->wall_cap = cap;
+}
+
+/** \brief gets the first and last cell touched by rect, anything outside
+ * of the partition ends up in the border cells */
+static void cell_range(ldtk_part *part, ldtk_rect rect, i32 *x0, i32 *y0,
+		       i32 *x1, i32 *y1)
+{
+	i32 rx = rect.x - part->rect.x;
+	i32 ry = rect.y - part->rect.y;
+	i32 w = rect.w > 0 ? rect.w : 1;
+	i32 h = rect.h > 0 ? rect.h : 1;
+	*x0 = cell_clamp(rx, part->cell_size, part->cw);
+	*y0 = cell_clamp(ry, part->cell_size, part->ch);
+	*x1 = cell_clamp(rx + w - 1, part->cell_size, part->cw);
+	*y1 = cell_clamp(ry + h - 1, part->cell_size, part->ch);
+}
+
+/** \brief the cell of the pixel v, clamped to [0, max) */
+static i32 cell_clamp(i32 v, i32 cell_size, i32 max)
+{
+	// round towards negative infinity so -1 isn't cell 0
+	i32 cell = v >= 0 ? v / cell_size : -((-v + cell_size - 1) / cell_size);
+	if (cell < 0)
+		return 0;
+	if (cell >= max)
+		return max - 1;
+	return cell;
+}
+
+static bool rect_overlap(ldtk_rect a, ldtk_rect b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+	       b.y < a.y + a.h;
+}
+
+/** \brief an object overlapping the area is listed in every cell it touches,
+ * so it's only reported by the cell holding the top left corner of the
+ * overlap, this way queries need no memory to remember what they found */
+static bool owns_overlap(ldtk_part *part, ldtk_rect obj, ldtk_rect area,
+			 i32 cx, i32 cy)
+{
+	if (!rect_overlap(obj, area))
+		return false;
+
+	ldtk_rect corner = { obj.x > area.x ? obj.x : area.x,
+			     obj.y > area.y ? obj.y : area.y, 1, 1 };
+	i32 x0, y0, x1, y1;
+	cell_range(part, corner, &x0, &y0, &x1, &y1);
+	return x0 == cx && y0 == cy;
+}
+
+/** \brief collects a pointer to every entity of every entity layer */
+static void gather_ents(ldtk_lvl *lvl, bunlist *ents)
+{
+	for (u32 i = 0; i < lvl->layers->len; i++) {
+		ldtk_layer *layer = bunlist_get(lvl->layers, i);
+		if (layer->type != LDTK_LAYER_ENTITY)
+			continue;
+		for (u32 j = 0; j < layer->content->len; j++) {
+			ldtk_ent *ent = bunlist_get(layer->content, j);
+			bunlist_append(ents, &ent);
+		}
+	}
+}
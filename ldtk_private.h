@@ -0,0 +1,17 @@
+/* ldtk_private.h - helpers shared by the ldtk_*.c files,
+ * they are not part of the api in ldtk.h */
+
+#pragma once
+#include "ldtk.h"
+
+/** \brief FNV-1a hash of a null terminated string, used by the level index 
+ * and the field tables */
+u32 ldtk_hash_str(const char *str);
+
+/** \brief takes wall i of lvl->walls out of the cells of the partition,
+ * call it before the wall changes or moves */
+void ldtk_part_remove_wall(ldtk_lvl *lvl, u32 i);
+
+/** \brief puts wall i of lvl->walls into the cells it overlaps, only those
+ * cells are touched, a full one moves to the end of part->wall_idx */
+void ldtk_part_add_wall(ldtk_lvl *lvl, u32 i);
@@ -0,0 +1,456 @@
+/** ldtk_watch.c - hot reloading, watches the project files
+* with inotify and rebuilds in place only the layers
+* of the loaded levels whose content hash changed */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "ldtk.h"
+
+typedef struct watch_dir {
+	char *path; // with the trailing /, empty for the working directory
+	i32 wd;
+} watch_dir;
+
+typedef struct watch_lvl {
+	ldtk_lvl *lvl;
+	char *file; // the file the level is stored in
+	u64 fields_hash;
+	u64 *layer_hashes; // hash of each layer instance, by z
+	u32 layer_count;
+	bool dirty; // its file changed since the last poll
+} watch_lvl;
+
+/** a file parsed during one poll, shared by every level stored in it */
+typedef struct watch_file {
+	const char *path;
+	json_object *root; // NULL if it can't be parsed
+} watch_file;
+
+struct ldtk_watch {
+	ldtk_ctx *ctx;
+	i32 fd;
+	bunlist *dirs; // watch_dir
+	bunlist *lvls; // watch_lvl
+	char *prj_file; // the main file of the project
+	u64 prj_hash; // hash of the definitions and the level list
+	bool prj_dirty;
+};
+
+#ifdef __linux__
+
+static bool watch_dir_of(ldtk_watch *watch, const char *file);
+static json_object *read_file(bunlist *files, const char *path);
+static json_object *find_lvl(json_object *root, ldtk_lvl_info *info);
+static void hash_lvl(json_object *lvl_json, watch_lvl *rec);
+static u64 hash_prj(json_object *root);
+static u64 hash_json(json_object *obj);
+static u64 hash_str(u64 hash, const char *str);
+static u32 reload_lvl(ldtk_watch *watch, watch_lvl *rec,
+		      json_object *lvl_json, bunlist *changes);
+static void free_dir(usize i, void *itm);
+static void free_file(usize i, void *itm);
+static void free_watch_lvl(usize i, void *itm);
+
+ldtk_watch *ldtk_watch_start(ldtk_ctx *ctx)
+{
+	i32 fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	ldtk_watch *watch = malloc(sizeof(ldtk_watch));
+	watch->ctx = ctx;
+	watch->fd = fd;
+	watch->dirs = bunlist_create(sizeof(watch_dir), 2, free_dir);
+	watch->lvls = bunlist_create(sizeof(watch_lvl), 4, free_watch_lvl);
+	watch->prj_dirty = false;
+
+	char path[300];
+	snprintf(path, sizeof(path), "%s%s%s", ctx->prj_dir, ctx->prj_name,
+		 (ctx->flags & LDTK_EXTENSION_JSON) != 0 ? ".json" : ".ldtk");
+	watch->prj_file = strdup(path);
+	json_object *root = json_object_from_file(path);
+	if (root == NULL || !watch_dir_of(watch, path)) {
+		json_object_put(root);
+		ldtk_watch_stop(watch);
+		return NULL;
+	}
+	watch->prj_hash = hash_prj(root);
+	json_object_put(root);
+	return watch;
+}
+
+bool ldtk_watch_add(ldtk_watch *watch, ldtk_lvl *lvl)
+{
+	for (u32 i = 0; i < watch->lvls->len; i++) {
+		watch_lvl *rec = bunlist_get(watch->lvls, i);
+		if (rec->lvl == lvl)
+			return true;
+	}
+	ldtk_lvl_info *info = ldtk_get_lvl_info_ctx(watch->ctx, lvl->id);
+	if (info == NULL || !watch_dir_of(watch, info->path))
+		return false;
+	json_object *root = json_object_from_file(info->path);
+	json_object *lvl_json = find_lvl(root, info);
+	if (lvl_json == NULL) {
+		json_object_put(root);
+		return false;
+	}
+
+	watch_lvl rec = { .lvl = lvl,
+			  .file = strdup(info->path),
+			  .layer_hashes = NULL,
+			  .dirty = false };
+	hash_lvl(lvl_json, &rec);
+	json_object_put(root);
+	bunlist_append(watch->lvls, &rec);
+	return true;
+}
+
+void ldtk_watch_remove(ldtk_watch *watch, ldtk_lvl *lvl)
+{
+	for (u32 i = 0; i < watch->lvls->len; i++) {
+		watch_lvl *rec = bunlist_get(watch->lvls, i);
+		if (rec->lvl == lvl) {
+			bunlist_remove(watch->lvls, i);
+			return;
+		}
+	}
+}
+
+u32 ldtk_watch_poll(ldtk_watch *watch,
+		    void (*on_change)(ldtk_change *change, void *user),
+		    void *user)
+{
+	// editors save through a temporary file and a rename,
+	// so the directories are watched and events matched by path
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char path[512];
+	ssize_t n;
+	while ((n = read(watch->fd, buf, sizeof(buf))) > 0) {
+		for (char *at = buf; at < buf + n;) {
+			struct inotify_event *ev = (struct inotify_event *)at;
+			at += sizeof(struct inotify_event) + ev->len;
+			if (ev->len == 0)
+				continue;
+			path[0] = '\0';
+			for (u32 i = 0; i < watch->dirs->len; i++) {
+				watch_dir *dir = bunlist_get(watch->dirs, i);
+				if (dir->wd != ev->wd)
+					continue;
+				snprintf(path, sizeof(path), "%s%s", dir->path,
+					 ev->name);
+			}
+			if (strcmp(watch->prj_file, path) == 0) {
+				watch->prj_dirty = true;
+			}
+			for (u32 i = 0; i < watch->lvls->len; i++) {
+				watch_lvl *rec = bunlist_get(watch->lvls, i);
+				if (strcmp(rec->file, path) == 0) {
+					rec->dirty = true;
+				}
+			}
+		}
+	}
+
+	// every changed file is parsed once, in single file mode all the
+	// levels and the project are looked up in the same json
+	bunlist *files = bunlist_create(sizeof(watch_file), 2, free_file);
+	bunlist *changes = bunlist_create(sizeof(ldtk_change), 8, NULL);
+	if (watch->prj_dirty) {
+		watch->prj_dirty = false;
+		json_object *root = read_file(files, watch->prj_file);
+		u64 hash = root != NULL ? hash_prj(root) : watch->prj_hash;
+		if (hash != watch->prj_hash) {
+			watch->prj_hash = hash;
+			ldtk_change change = { .lvl = NULL,
+					       .layer = NULL,
+					       .z = 0,
+					       .what = LDTK_CHANGE_RELOAD };
+			bunlist_append(changes, &change);
+		}
+	}
+	for (u32 i = 0; i < watch->lvls->len; i++) {
+		watch_lvl *rec = bunlist_get(watch->lvls, i);
+		if (!rec->dirty)
+			continue;
+		rec->dirty = false;
+		ldtk_lvl_info *info =
+			ldtk_get_lvl_info_ctx(watch->ctx, rec->lvl->id);
+		json_object *lvl_json =
+			info != NULL ?
+				find_lvl(read_file(files, rec->file), info) :
+				NULL;
+		// half written, the next write brings it back
+		if (lvl_json != NULL) {
+			reload_lvl(watch, rec, lvl_json, changes);
+		}
+	}
+	bunlist_destroy(files);
+	if (on_change != NULL) {
+		for (u32 i = 0; i < changes->len; i++) {
+			on_change(bunlist_get(changes, i), user);
+		}
+	}
+	u32 count = changes->len;
+	bunlist_destroy(changes);
+	return count;
+}
+
+i32 ldtk_watch_fd(ldtk_watch *watch)
+{
+	return watch->fd;
+}
+
+void ldtk_watch_stop(ldtk_watch *watch)
+{
+	close(watch->fd);
+	bunlist_destroy(watch->dirs);
+	bunlist_destroy(watch->lvls);
+	free(watch->prj_file);
+	free(watch);
+}
+
+/** \brief compares the new hashes of the level with the old ones and
+ * rebuilds what differs, the changes are appended to changes
+ * \param lvl_json the level in its file, owned by the poll
+ * \return the number of changes */
+static u32 reload_lvl(ldtk_watch *watch, watch_lvl *rec,
+		      json_object *lvl_json, bunlist *changes)
+{
+	// hash before decoding, decoding modifies the json
+	watch_lvl old = *rec;
+	hash_lvl(lvl_json, rec);
+	u32 count = changes->len;
+	ldtk_change change = { .lvl = rec->lvl, .layer = NULL, .z = 0 };
+
+	if (rec->fields_hash != old.fields_hash) {
+		ldtk_reload_fields(rec->lvl, json_object_object_get(
+						     lvl_json, "fieldInstances"));
+		change.what = LDTK_CHANGE_FIELDS;
+		bunlist_append(changes, &change);
+	}
+
+	json_object *layers =
+		json_object_object_get(lvl_json, "layerInstances");
+	bool rebuild = false;
+	if (rec->layer_count != old.layer_count) {
+		// the level keeps its old layers until it is loaded again,
+		// so it keeps their hashes and the next change reports it again
+		free(rec->layer_hashes);
+		rec->layer_hashes = old.layer_hashes;
+		rec->layer_count = old.layer_count;
+		old.layer_hashes = NULL;
+		change.what = LDTK_CHANGE_RELOAD;
+		bunlist_append(changes, &change);
+	} else {
+		for (u32 z = 0; z < rec->layer_count; z++) {
+			if (rec->layer_hashes[z] == old.layer_hashes[z])
+				continue;
+			change.what = ldtk_reload_layer(
+				rec->lvl, json_object_array_get_idx(layers, z),
+				z);
+			change.z = z;
+			if (change.what == LDTK_CHANGE_RELOAD) {
+				rec->layer_hashes[z] = old.layer_hashes[z];
+			}
+			if (change.what == 0)
+				continue;
+			rebuild |= change.what != LDTK_CHANGE_RELOAD;
+			bunlist_append(changes, &change);
+		}
+	}
+	free(old.layer_hashes);
+
+	if (rebuild) {
+		ldtk_rebuild_queries(rec->lvl);
+	}
+	// the layer list is settled now, point the changes at the new layers
+	for (u32 i = count; i < changes->len; i++) {
+		ldtk_change *change_i = bunlist_get(changes, i);
+		if (change_i->what & (LDTK_CHANGE_FIELDS | LDTK_CHANGE_RELOAD))
+			continue;
+		for (u32 j = 0; j < rec->lvl->layers->len; j++) {
+			ldtk_layer *layer = bunlist_get(rec->lvl->layers, j);
+			if (layer->z == change_i->z) {
+				change_i->layer = layer;
+			}
+		}
+	}
+	return changes->len - count;
+}
+
+/** \brief watches the directory of file, once per directory */
+static bool watch_dir_of(ldtk_watch *watch, const char *file)
+{
+	const char *slash = strrchr(file, '/');
+	usize len = slash != NULL ? (usize)(slash - file) + 1 : 0;
+	char *path = malloc(len + 1);
+	memcpy(path, file, len);
+	path[len] = '\0';
+	for (u32 i = 0; i < watch->dirs->len; i++) {
+		watch_dir *dir = bunlist_get(watch->dirs, i);
+		if (strcmp(dir->path, path) == 0) {
+			free(path);
+			return true;
+		}
+	}
+	i32 wd = inotify_add_watch(watch->fd, len > 0 ? path : ".",
+				   IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0) {
+		free(path);
+		return false;
+	}
+	watch_dir dir = { .path = path, .wd = wd };
+	bunlist_append(watch->dirs, &dir);
+	return true;
+}
+
+/** \brief parses the file at path, or gives back the json it was
+ * parsed into earlier in the same poll
+ * \return the json owned by files, or NULL if it can't be parsed */
+static json_object *read_file(bunlist *files, const char *path)
+{
+	for (u32 i = 0; i < files->len; i++) {
+		watch_file *file = bunlist_get(files, i);
+		if (strcmp(file->path, path) == 0)
+			return file->root;
+	}
+	watch_file file = { .path = path,
+			    .root = json_object_from_file(path) };
+	bunlist_append(files, &file);
+	return file.root;
+}
+
+/** \brief finds the level in the json of its file, the file itself
+ * or its entry in the main file in single file mode
+ * \return the level json, owned by root, or NULL */
+static json_object *find_lvl(json_object *root, ldtk_lvl_info *info)
+{
+	if (root == NULL)
+		return NULL;
+	usize len = strlen(info->path);
+	if (len > 6 && strcmp(info->path + len - 6, ".ldtkl") == 0)
+		return root;
+
+	json_object *lvls = json_object_object_get(root, "levels");
+	for (usize i = 0; i < json_object_array_length(lvls); i++) {
+		json_object *lvl_i = json_object_array_get_idx(lvls, i);
+		const char *iid = json_object_get_string(
+			json_object_object_get(lvl_i, "iid"));
+		if (iid != NULL && strcmp(iid, info->iid) == 0)
+			return lvl_i;
+	}
+	return NULL;
+}
+
+/** \brief takes the hash of the fields and of every layer instance */
+static void hash_lvl(json_object *lvl_json, watch_lvl *rec)
+{
+	json_object *layers =
+		json_object_object_get(lvl_json, "layerInstances");
+	rec->fields_hash = hash_json(
+		json_object_object_get(lvl_json, "fieldInstances"));
+	rec->layer_count = layers != NULL ? json_object_array_length(layers) :
+					    0;
+	rec->layer_hashes = malloc(sizeof(u64) * (rec->layer_count + 1));
+	for (u32 z = 0; z < rec->layer_count; z++) {
+		rec->layer_hashes[z] =
+			hash_json(json_object_array_get_idx(layers, z));
+	}
+}
+
+/** \brief hash of what ldtk_init reads from the main file: the
+ * definitions and where each level is, but not the level contents,
+ * which the watched levels follow on their own */
+static u64 hash_prj(json_object *root)
+{
+	const char *keys[] = { "iid",    "identifier", "worldX",
+			       "worldY", "pxWid",      "pxHei" };
+	u64 hash = hash_json(json_object_object_get(root, "defs"));
+	json_object *lvls = json_object_object_get(root, "levels");
+	for (usize i = 0; i < json_object_array_length(lvls); i++) {
+		json_object *lvl_i = json_object_array_get_idx(lvls, i);
+		for (u32 k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+			hash = hash_str(hash, json_object_to_json_string_ext(
+						      json_object_object_get(
+							      lvl_i, keys[k]),
+						      JSON_C_TO_STRING_PLAIN));
+		}
+	}
+	return hash;
+}
+
+/** \brief 64 bit FNV-1a of the json text, the same json always prints the same */
+static u64 hash_json(json_object *obj)
+{
+	return hash_str(14695981039346656037ull,
+			json_object_to_json_string_ext(obj,
+						       JSON_C_TO_STRING_PLAIN));
+}
+
+/** \brief continues the 64 bit FNV-1a hash with the bytes of str */
+static u64 hash_str(u64 hash, const char *str)
+{
+	for (; *str != '\0'; str++) {
+		hash ^= (u8)*str;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static void free_dir(usize i, void *itm)
+{
+	watch_dir *dir = itm;
+	free(dir->path);
+}
+
+static void free_file(usize i, void *itm)
+{
+	watch_file *file = itm;
+	json_object_put(file->root);
+}
+
+static void free_watch_lvl(usize i, void *itm)
+{
+	watch_lvl *rec = itm;
+	free(rec->file);
+	free(rec->layer_hashes);
+}
+
+#else
+
+ldtk_watch *ldtk_watch_start(ldtk_ctx *ctx)
+{
+	return NULL;
+}
+
+bool ldtk_watch_add(ldtk_watch *watch, ldtk_lvl *lvl)
+{
+	return false;
+}
+
+void ldtk_watch_remove(ldtk_watch *watch, ldtk_lvl *lvl)
+{
+}
+
+u32 ldtk_watch_poll(ldtk_watch *watch,
+		    void (*on_change)(ldtk_change *change, void *user),
+		    void *user)
+{
+	return 0;
+}
+
+i32 ldtk_watch_fd(ldtk_watch *watch)
+{
+	return -1;
+}
+
+void ldtk_watch_stop(ldtk_watch *watch)
+{
+}
+
+#endif